@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
+#include <iterator>
 #include <numeric>
 
 namespace aeh
@@ -18,6 +20,12 @@ namespace aeh
 	template <typename It> requires std::forward_iterator<It> && requires(It a) { *a + *a; }
 	constexpr auto sum(It begin, It end) noexcept -> std::decay_t<decltype(*begin)>;
 
+	// Same result as std::lower_bound, but the only branch in the loop depends on the size of the range, not on the values
+	// compared. The comparison picks the next position with a conditional move, so searches don't mispredict. Faster
+	// than std::lower_bound for small, cheap to compare values such as numbers.
+	template <std::random_access_iterator It, typename T, typename Compare = std::less<>>
+	constexpr auto branchless_lower_bound(It first, It last, T const & value, Compare compare = Compare()) -> It;
+
 	//template <typename R>
 	//constexpr auto sum(R && range) noexcept -> decltype(sum(std::begin(range), std::end(range)));
 
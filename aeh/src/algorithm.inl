@@ -35,6 +35,23 @@ namespace aeh
 		return std::accumulate(begin, end, value_type(0));
 	}
 
+	template <std::random_access_iterator It, typename T, typename Compare>
+	constexpr auto branchless_lower_bound(It first, It last, T const & value, Compare compare) -> It
+	{
+		auto length = last - first;
+		if (length == 0)
+			return first;
+
+		// The answer is always in [first, first + length].
+		while (length > 1)
+		{
+			auto const half = length / 2;
+			first += compare(first[half], value) ? half : 0;
+			length -= half;
+		}
+		return first + (compare(*first, value) ? 1 : 0);
+	}
+
 	template <typename R>
 	constexpr auto sum(R && range) noexcept -> decltype(sum(std::begin(range), std::end(range)))
 	{
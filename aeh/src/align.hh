@@ -5,6 +5,10 @@
 namespace aeh
 {
 
+	// Size to pad to in order to keep data written by different threads from sharing a cache line.
+	// Not std::hardware_destructive_interference_size because its value may change between compiler flags.
+	constexpr size_t cache_line_size = 64;
+
 	template <typename T>
 	constexpr auto align(T p, T alignment) noexcept -> T
 	{
@@ -1,22 +1,114 @@
+#pragma once
+
+#include "align.hh"
+#include "debug/assert.hh"
+#include "pointer_union.hh"
 #include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
-#include <mutex>
 #include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <thread>
+#include <stop_token>
+#include <cstdint>
 
 namespace aeh
 {
 
+	// Default executor. Creates a new thread per worker on every call. For short jobs that run often,
+	// pass an aeh::ThreadPool instead to reuse the same workers (see thread_pool.hh).
 	constexpr auto run_in_new_thread = [](auto && f, auto && ... args) 
 	{
 		return std::thread(std::forward<decltype(f)>(f), std::forward<decltype(args)>(args)...); 
 	};
 
+	enum struct BatchedParallelWorkScheduling
+	{
+		// All workers take the next task index from a single atomic counter.
+		shared_index,
+		// Each worker owns a range of task indices and steals half of another worker's range when its own runs out.
+		// Avoids contention on a single counter with many workers and cheap tasks. Falls back to shared_index when
+		// total_work does not fit in 32 bits.
+		work_stealing,
+	};
+
+	// Where time goes in a job, to tell whether it is limited by the workers or by process. Only collected when aeh is
+	// built with AEH_WITH_BATCHED_PARALLEL_WORK_STATS. Otherwise collection compiles away and stats are left untouched.
+	struct BatchedParallelWorkStats
+	{
+		struct Thread
+		{
+			size_t tasks_performed = 0;
+			std::chrono::nanoseconds time_in_tasks = std::chrono::nanoseconds::zero();
+			// Workers are idle while they wait for room in the window of a streaming job. The calling thread
+			// is idle when it has no work to claim and no batch to process.
+			std::chrono::nanoseconds time_idle = std::chrono::nanoseconds::zero();
+		};
+
+		// The calling thread first, then workers in the order they were launched.
+		std::vector<Thread> threads;
+		// Time the calling thread spent in process.
+		std::chrono::nanoseconds time_in_process = std::chrono::nanoseconds::zero();
+		size_t batches_processed = 0;
+		// Most batches the calling thread found ready to be processed at once.
+		size_t peak_batches_waiting = 0;
+		// Most batches that held results at once, whether complete or not.
+		size_t peak_batches_buffered = 0;
+	};
+
+	struct BatchedParallelWorkOptions
+	{
+		BatchedParallelWorkScheduling scheduling = BatchedParallelWorkScheduling::shared_index;
+		// Number of consecutive tasks a worker claims with a single atomic operation. Tasks in a claimed range are
+		// published as completed together, so a bigger grain means less traffic on shared counters for cheap tasks,
+		// at the cost of coarser load balancing.
+		size_t grain = 1;
+		// Streaming mode. When not 0, at most this many batches are buffered between the workers and process, in a ring
+		// of result buffers allocated up front. Workers that get too far ahead wait for process to catch up, so peak memory
+		// is max_batches_in_flight * batch_size results regardless of total_work. Scheduling is always shared_index.
+		size_t max_batches_in_flight = 0;
+		// Adaptive batch sizing. When greater than batch_size, batch_size becomes the smallest a batch can be and
+		// batches get bigger or smaller along the job, up to this size, depending on how long tasks and process take.
+		// Result buffers hold max_batch_size results each. Scheduling is always shared_index.
+		size_t max_batch_size = 0;
+		// Adaptive batch sizing aims for batches that take about this long to compute with all threads or to process,
+		// whichever is slower.
+		std::chrono::nanoseconds target_batch_duration = std::chrono::microseconds(100);
+		// Overwritten with the stats of the job, if collection was compiled in.
+		BatchedParallelWorkStats * stats = nullptr;
+		// Requesting a stop on this token has the same effect as process returning BatchedParallelWorkFlow::stop.
+		std::stop_token stop_token;
+	};
+
+	// What process may return to control the job. Returning void is the same as always returning keep_going.
+	enum struct BatchedParallelWorkFlow
+	{
+		keep_going,
+		// Workers stop claiming new tasks and process is not called again. Tasks that were already running finish
+		// and their results are destroyed without being processed.
+		stop,
+	};
+
+	struct BatchedParallelWorkProgress
+	{
+		// Results of tasks [0, processed_work) were passed to process.
+		size_t processed_work;
+		// Whether the job was stopped before every result was processed.
+		bool stopped;
+		// With adaptive batch sizing, the size of every batch passed to process, in order. Empty otherwise.
+		std::vector<size_t> batch_sizes;
+	};
+
+	// Results are constructed in place from the return value of task and destroyed right after process returns,
+	// so they don't need to be default constructible or movable. process may move out of them.
 	template <typename Task, typename Process, typename Executor = decltype(run_in_new_thread) const &>
-	void batched_parallel_work(
+	BatchedParallelWorkProgress batched_parallel_work(
 		size_t total_work, size_t batch_size, size_t worker_count, 
 		Task const & task, Process const & process, 
-		Executor && executor = run_in_new_thread);
+		Executor && executor = run_in_new_thread,
+		BatchedParallelWorkOptions const & options = BatchedParallelWorkOptions());
 
 } // namespace aeh
 
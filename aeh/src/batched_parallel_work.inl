@@ -2,129 +2,866 @@ namespace aeh
 {
 	namespace detail
 	{
+		// Uninitialized storage for the results of a batch. Tasks construct results in place and they are
+		// destroyed after being processed, so T need not be default constructible, or even movable.
 		template <typename T>
-		struct Batch
+		struct ResultBuffer
 		{
-			std::unique_ptr<T[]> results = nullptr;
+			explicit ResultBuffer(size_t batch_size)
+				: results(std::allocator<T>().allocate(batch_size))
+				, capacity(batch_size)
+			{}
+
+			ResultBuffer(ResultBuffer const &) = delete;
+			auto operator = (ResultBuffer const &) -> ResultBuffer & = delete;
+			~ResultBuffer() { std::allocator<T>().deallocate(results, capacity); }
+
+			T * results;
+			size_t capacity;
+			std::atomic<ResultBuffer *> next_free = nullptr;
+		};
+
+		// Padded so that workers completing tasks of neighbouring batches don't fight over the same cache line.
+		template <typename T>
+		struct alignas(cache_line_size) Batch
+		{
+			std::atomic<ResultBuffer<T> *> buffer = nullptr;
 			std::atomic<size_t> completed_work = 0;
+
+			T * results() const noexcept { return buffer.load(std::memory_order_acquire)->results; }
+		};
+
+		// Lock-free stack of result buffers that are not in use by any batch. The head pointer carries a counter
+		// in its unused high bits that changes on every push and pop, which prevents ABA problems.
+		// Buffers are never deallocated while the job runs, so reading the next pointer of a buffer
+		// that someone else popped in the meantime is safe, and the CAS will fail anyway.
+		template <typename T>
+		struct ResultBufferFreeList
+		{
+			ResultBufferFreeList() noexcept = default;
+			ResultBufferFreeList(ResultBufferFreeList const &) = delete;
+			auto operator = (ResultBufferFreeList const &) -> ResultBufferFreeList & = delete;
+
+			~ResultBufferFreeList()
+			{
+				while (ResultBuffer<T> * const buffer = pop())
+					delete buffer;
+			}
+
+			void push(ResultBuffer<T> * buffer) noexcept
+			{
+				tagged_pointer_t head = top.load(std::memory_order_relaxed);
+				tagged_pointer_t new_head;
+				do
+				{
+					buffer->next_free.store(head.pointer(), std::memory_order_relaxed);
+					new_head = tagged_pointer_t(buffer, uint16_t(head.extra_data() + 1));
+				} while (!top.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			// Returns nullptr if the list is empty.
+			ResultBuffer<T> * pop() noexcept
+			{
+				tagged_pointer_t head = top.load(std::memory_order_acquire);
+				while (head)
+				{
+					auto const new_head = tagged_pointer_t(head->next_free.load(std::memory_order_relaxed), uint16_t(head.extra_data() + 1));
+					if (top.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+						return head.pointer();
+				}
+				return nullptr;
+			}
+
+		private:
+			using tagged_pointer_t = PointerUnion<ResultBuffer<T>, uint16_t>;
+			alignas(cache_line_size) std::atomic<tagged_pointer_t> top;
 		};
 
+		// Storage for the results of all batches of the job. Result buffers are allocated as workers
+		// reach new batches and go to a free list once processed, so that later batches reuse them
+		// and the heap is only touched while workers get further ahead than they have been before.
 		template <typename T>
 		struct Work
 		{
-			std::vector<Batch<T>> batches;
-			std::mutex batch_allocation_mutex;
-			size_t last_allocated_batch;
+			using value_type = T;
 
-			Work(size_t batch_count)
+			Work(size_t batch_count, size_t /*batch_size*/)
 				: batches(batch_count)
-				, last_allocated_batch(0)
 			{}
 
+			~Work()
+			{
+				for (Batch<T> & batch : batches)
+					delete batch.buffer.load(std::memory_order_relaxed);
+			}
+
+			// There is no limit to how far ahead workers may get.
+			static constexpr bool bounded = false;
+			static constexpr bool can_write_batch(size_t) noexcept { return true; }
+			static void wait_until_can_write_batch(size_t) noexcept {}
+
+			Batch<T> & batch_to_process(size_t i) noexcept { return batches[i]; }
+
 			Batch<T> & batch_at(size_t i, size_t batch_size)
 			{
-				if (batches[i].results)
-					return batches[i];
+				Batch<T> & batch = batches[i];
+				if (batch.buffer.load(std::memory_order_acquire) != nullptr)
+					return batch;
+
+				ResultBuffer<T> * buffer = free_buffers.pop();
+				if (buffer == nullptr)
+					buffer = new ResultBuffer<T>(batch_size);
+
+				// Another worker with tasks in the same batch may have beaten us to it.
+				ResultBuffer<T> * expected = nullptr;
+				if (!batch.buffer.compare_exchange_strong(expected, buffer, std::memory_order_acq_rel, std::memory_order_acquire))
+					free_buffers.push(buffer);
+
+				return batch;
+			}
+
+			// Called once batch i has been processed.
+			void free_batch(size_t i) noexcept
+			{
+				free_buffers.push(batches[i].buffer.exchange(nullptr, std::memory_order_relaxed));
+			}
+
+		private:
+			std::vector<Batch<T>> batches;
+			ResultBufferFreeList<T> free_buffers;
+		};
+
+		// Storage for a fixed window of batches. Batch i lives in slot i % window size and workers can't write to it until
+		// the batch that used the slot before has been processed, so memory use doesn't depend on the size of the job.
+		template <typename T>
+		struct WindowedWork
+		{
+			using value_type = T;
+
+			WindowedWork(size_t window_size, size_t batch_size)
+				: slots(window_size)
+			{
+				for (Batch<T> & slot : slots)
+					slot.buffer.store(&buffers.emplace_back(batch_size), std::memory_order_relaxed);
+			}
+
+			static constexpr bool bounded = true;
+
+			bool can_write_batch(size_t i) const noexcept
+			{
+				return i < batches_processed.load(std::memory_order_acquire) + slots.size();
+			}
+
+			void wait_until_can_write_batch(size_t i) const noexcept
+			{
+				for (size_t processed = batches_processed.load(std::memory_order_acquire); i >= processed + slots.size(); processed = batches_processed.load(std::memory_order_acquire))
+					batches_processed.wait(processed, std::memory_order_acquire);
+			}
+
+			Batch<T> & batch_at(size_t i, size_t /*batch_size*/) noexcept { return slots[i % slots.size()]; }
+			Batch<T> & batch_to_process(size_t i) noexcept { return slots[i % slots.size()]; }
+
+			// Called once batch i has been processed. Recycles its slot for batch i + window size.
+			void free_batch(size_t i) noexcept
+			{
+				slots[i % slots.size()].completed_work.store(0, std::memory_order_relaxed);
+				batches_processed.store(i + 1, std::memory_order_release);
+				batches_processed.notify_all();
+			}
+
+		private:
+			std::vector<Batch<T>> slots;
+			std::deque<ResultBuffer<T>> buffers;
+			alignas(cache_line_size) std::atomic<size_t> batches_processed = 0;
+		};
+
+		// All workers take the next indices from the same counter.
+		struct alignas(cache_line_size) SharedIndexScheduler
+		{
+			explicit SharedIndexScheduler(size_t total_work_, size_t /*worker_count*/, size_t grain_) noexcept
+				: total_work(total_work_)
+				, grain(grain_)
+			{}
+
+			// Claims up to grain consecutive indices in [begin, end). Returns false when there is no work left.
+			bool claim(size_t /*worker_index*/, size_t & begin, size_t & end) noexcept
+			{
+				if (stop_requested())
+					return false;
+
+				begin = index.fetch_add(grain, std::memory_order_relaxed);
+				end = std::min(begin + grain, total_work);
+				return begin < total_work;
+			}
+
+			// May be called from any thread. Workers stop claiming work soon after.
+			void request_stop() noexcept { stopping.store(true, std::memory_order_relaxed); }
+			bool stop_requested() const noexcept { return stopping.load(std::memory_order_relaxed); }
 
-				auto const g = std::lock_guard(batch_allocation_mutex);
-				if (batches[i].results)
+			// Called by the calling thread after a stop. No more indices can be claimed after this returns.
+			void stop_claiming() noexcept
+			{
+				request_stop();
+				// A worker that got past the check in claim gets an index past the end from here on.
+				claimed_end = std::min(index.exchange(total_work, std::memory_order_relaxed), total_work);
+			}
+
+			// Only valid after stop_claiming. Claimed indices are always a prefix of the job.
+			bool was_claimed(size_t i) const noexcept { return i < claimed_end; }
+
+		private:
+			size_t total_work;
+			size_t grain;
+			std::atomic<bool> stopping = false;
+			size_t claimed_end = total_work;
+			// On a cache line of its own, away from the read only data above.
+			alignas(cache_line_size) std::atomic<size_t> index = 0;
+		};
+
+		// Each worker owns a range of indices, which it consumes from the front. When it runs out,
+		// it steals the back half of the range of some other worker. Begin and end of each range are
+		// packed in a single 64 bit word so that both the owner and thieves can update it with a CAS.
+		struct WorkStealingScheduler
+		{
+			static constexpr size_t max_total_work = UINT32_MAX;
+
+			explicit WorkStealingScheduler(size_t total_work, size_t worker_count, size_t grain_)
+				: ranges(worker_count)
+				, grain(grain_)
+			{
+				debug_assert(total_work <= max_total_work);
+				// Contiguous slices so that the first batches belong to worker 0, which is the calling thread.
+				for (size_t i = 0; i < worker_count; ++i)
+					ranges[i].bounds.store(pack(total_work * i / worker_count, total_work * (i + 1) / worker_count), std::memory_order_relaxed);
+			}
+
+			// Claims up to grain consecutive indices in [begin, end). Returns false when there is no work left.
+			bool claim(size_t worker_index, size_t & begin, size_t & end) noexcept
+			{
+				if (stop_requested())
+					return false;
+
+				std::atomic<uint64_t> & own = ranges[worker_index].bounds;
+				uint64_t current = own.load(std::memory_order_relaxed);
+				while (begin_of(current) < end_of(current))
 				{
-					return batches[i];
+					size_t const claimed_end = std::min(begin_of(current) + grain, end_of(current));
+					if (own.compare_exchange_weak(current, pack(claimed_end, end_of(current)), std::memory_order_acq_rel, std::memory_order_relaxed))
+					{
+						begin = begin_of(current);
+						end = claimed_end;
+						return true;
+					}
 				}
 
-				batches[i].results = std::make_unique<T[]>(batch_size);
-				last_allocated_batch = i;
-				return batches[i];
+				return steal(worker_index, begin, end);
 			}
 
-			void free_batch(size_t i)
+			// May be called from any thread. Workers stop claiming work soon after.
+			void request_stop() noexcept { stopping.store(true, std::memory_order_relaxed); }
+			bool stop_requested() const noexcept { return stopping.load(std::memory_order_relaxed); }
+			void stop_claiming() noexcept { request_stop(); }
+
+			// Only valid once all workers have returned. Everything that isn't left in some range was claimed.
+			bool was_claimed(size_t i) const noexcept
 			{
-				if (last_allocated_batch == batches.size() - 1)
+				for (Range const & range : ranges)
 				{
-					batches[i].results = nullptr;
+					uint64_t const bounds = range.bounds.load(std::memory_order_relaxed);
+					if (begin_of(bounds) <= i && i < end_of(bounds))
+						return false;
 				}
-				else
+				return true;
+			}
+
+		private:
+			struct alignas(cache_line_size) Range
+			{
+				std::atomic<uint64_t> bounds = 0;
+			};
+
+			static constexpr uint64_t pack(size_t begin, size_t end) noexcept { return (uint64_t(begin) << 32) | uint64_t(end); }
+			static constexpr size_t begin_of(uint64_t bounds) noexcept { return size_t(bounds >> 32); }
+			static constexpr size_t end_of(uint64_t bounds) noexcept { return size_t(bounds & UINT32_MAX); }
+
+			bool steal(size_t thief_index, size_t & claimed_begin, size_t & claimed_end) noexcept
+			{
+				size_t const worker_count = ranges.size();
+				for (size_t offset = 1; offset < worker_count; ++offset)
 				{
-					batch_allocation_mutex.lock();
-					auto const it = std::find_if(batches.begin() + last_allocated_batch + 1, batches.end(), [](Batch<T> const & b) { return b.results == nullptr; });
-					if (it == batches.end())
-					{
-						batch_allocation_mutex.unlock();
-						batches[i].results = nullptr;
-					}
-					else
+					std::atomic<uint64_t> & victim = ranges[(thief_index + offset) % worker_count].bounds;
+					uint64_t current = victim.load(std::memory_order_relaxed);
+					while (begin_of(current) < end_of(current))
 					{
-						last_allocated_batch = it - batches.begin();
-						it->results = std::move(batches[i].results);
-						batch_allocation_mutex.unlock();
+						size_t const begin = begin_of(current);
+						size_t const end = end_of(current);
+						size_t const split = end - (end - begin + 1) / 2;
+						if (victim.compare_exchange_weak(current, pack(begin, split), std::memory_order_acq_rel, std::memory_order_relaxed))
+						{
+							// Only the owner writes to its own range other than through a CAS, and only when it's empty,
+							// so any thief that read the empty range will fail its CAS.
+							claimed_begin = split;
+							claimed_end = std::min(split + grain, end);
+							ranges[thief_index].bounds.store(pack(claimed_end, end), std::memory_order_release);
+							return true;
+						}
 					}
 				}
+				return false;
 			}
+
+			std::vector<Range> ranges;
+			size_t grain;
+			std::atomic<bool> stopping = false;
 		};
 
-		template <typename T, typename Task>
-		bool perform_task(std::atomic<size_t> & index, size_t total_work, size_t batch_size, Work<T> & work, Task const & task)
+		// Batches of batch_size tasks. The last batch is smaller when total work is not a multiple of batch size.
+		struct FixedBatches
 		{
-			size_t const next_task = index++;
-			if (next_task >= total_work)
-				return false;
+			FixedBatches(size_t total_work_, size_t batch_size_) noexcept
+				: total_work(total_work_)
+				, batch_size(batch_size_)
+			{}
+
+			static constexpr bool adaptive = false;
+
+			size_t max_batch_count() const noexcept { return total_work / batch_size + (total_work % batch_size > 0); }
+			size_t max_batch_size() const noexcept { return batch_size; }
+
+			static constexpr bool is_decided(size_t) noexcept { return true; }
+			size_t batch_of(size_t i) const noexcept { return i / batch_size; }
+			size_t begin_of(size_t batch_index) const noexcept { return batch_index * batch_size; }
+			size_t end_of(size_t batch_index) const noexcept { return std::min(begin_of(batch_index) + batch_size, total_work); }
+
+		private:
+			size_t total_work;
+			size_t batch_size;
+		};
 
-			size_t const batch_index = next_task / batch_size;
-			size_t const task_index_in_batch = next_task % batch_size;
-			Batch<T> & batch = work.batch_at(batch_index, batch_size);
-			batch.results[task_index_in_batch] = task(next_task);
-			batch.completed_work++;
-			return true;
+		// Batches whose size is decided when a worker first reaches them, from a target size that the calling thread
+		// adjusts as the job runs. Every batch but the last has between min_batch_size and max_batch_size tasks.
+		// Deciding new batches takes a lock, but that happens once per batch and only at the front of the job.
+		// Finding the batch of an index that is already decided doesn't.
+		struct AdaptiveBatches
+		{
+			AdaptiveBatches(size_t total_work_, size_t min_batch_size, size_t max_batch_size_)
+				: total_work(total_work_)
+				, min_size(min_batch_size)
+				, max_size(max_batch_size_)
+				, begins(total_work / min_batch_size + (total_work % min_batch_size > 0) + 1)
+				, target_size(min_batch_size)
+			{}
+
+			static constexpr bool adaptive = true;
+
+			size_t max_batch_count() const noexcept { return begins.size() - 1; }
+			size_t max_batch_size() const noexcept { return max_size; }
+
+			bool is_decided(size_t batch_index) const noexcept { return batch_index < decided_count.load(std::memory_order_acquire); }
+
+			size_t batch_of(size_t i)
+			{
+				size_t decided = decided_count.load(std::memory_order_acquire);
+				if (i >= begins[decided])
+					decided = decide_batches_up_to(i);
+				auto const decided_begins_end = begins.begin() + static_cast<ptrdiff_t>(decided + 1);
+				return static_cast<size_t>(std::upper_bound(begins.begin(), decided_begins_end, i) - begins.begin()) - 1;
+			}
+
+			// Only valid for batches that have been decided.
+			size_t begin_of(size_t batch_index) const noexcept { return begins[batch_index]; }
+			size_t end_of(size_t batch_index) const noexcept { return begins[batch_index + 1]; }
+
+			// Size of the batches decided from now on. Clamped to the bounds given on construction.
+			void set_target_size(size_t size) noexcept
+			{
+				target_size.store(std::clamp(size, min_size, max_size), std::memory_order_relaxed);
+			}
+
+			std::vector<size_t> sizes_of_first_batches(size_t batch_count) const
+			{
+				std::vector<size_t> sizes(batch_count);
+				for (size_t i = 0; i < batch_count; ++i)
+					sizes[i] = end_of(i) - begin_of(i);
+				return sizes;
+			}
+
+		private:
+			size_t decide_batches_up_to(size_t i)
+			{
+				auto const lock = std::lock_guard(decide_mutex);
+				size_t decided = decided_count.load(std::memory_order_relaxed);
+				size_t const size = target_size.load(std::memory_order_relaxed);
+				for (; begins[decided] <= i; ++decided)
+					begins[decided + 1] = std::min(begins[decided] + size, total_work);
+				decided_count.store(decided, std::memory_order_release);
+				return decided;
+			}
+
+			size_t total_work;
+			size_t min_size;
+			size_t max_size;
+			// begins[i] is the first task of batch i, and also the end of batch i - 1. Entries up to
+			// begins[decided_count] are never written again once decided_count has been published.
+			std::vector<size_t> begins;
+			alignas(cache_line_size) std::atomic<size_t> decided_count = 0;
+			std::atomic<size_t> target_size;
+			std::mutex decide_mutex;
+		};
+
+		// Picks the size of the batches of an adaptive job from how long tasks and process take, as measured by the
+		// calling thread. Batches should take about target_duration to compute with every thread, or to process,
+		// whichever is slower: long enough for per batch costs not to matter, short enough that process doesn't sit
+		// idle waiting for a huge batch, or take so long with one that workers run out of room.
+		struct BatchSizeController
+		{
+			using duration = std::chrono::duration<double, std::nano>;
+
+			void tasks_performed(size_t task_count, duration time) noexcept
+			{
+				update_average(task_time, time / double(task_count));
+			}
+
+			void batch_processed(size_t result_count, duration time) noexcept
+			{
+				update_average(process_time_per_result, time / double(result_count));
+			}
+
+			// Returns 0 until there is something to go by.
+			size_t batch_size(size_t thread_count, duration target_duration) const noexcept
+			{
+				duration const time_per_result = std::max(task_time / double(thread_count), process_time_per_result);
+				if (time_per_result <= duration::zero())
+					return 0;
+				return static_cast<size_t>(std::clamp(target_duration / time_per_result, 1.0, double(SIZE_MAX / 2)));
+			}
+
+		private:
+			// Exponential moving average, so that the size follows changes in cost along the job without jumping around.
+			static void update_average(duration & average, duration sample) noexcept
+			{
+				average = (average == duration::zero()) ? sample : average + (sample - average) / 4.0;
+			}
+
+			duration task_time = duration::zero();
+			duration process_time_per_result = duration::zero();
+		};
+
+#ifdef AEH_WITH_BATCHED_PARALLEL_WORK_STATS
+		constexpr bool collect_batched_parallel_work_stats = true;
+#else
+		constexpr bool collect_batched_parallel_work_stats = false;
+#endif
+
+		// Fills BatchedParallelWorkStats when the caller asks for them. When collection is not compiled in, now()
+		// doesn't read the clock and every other member function is empty, so all of it compiles away.
+		struct StatsCollector
+		{
+			using clock = std::chrono::steady_clock;
+
+			StatsCollector(BatchedParallelWorkStats * stats_, size_t thread_count)
+				: stats(collect_batched_parallel_work_stats ? stats_ : nullptr)
+				, threads(stats != nullptr ? thread_count : 0)
+			{}
+
+			bool is_recording() const noexcept
+			{
+				if constexpr (collect_batched_parallel_work_stats)
+					return stats != nullptr;
+				else
+					return false;
+			}
+
+			clock::time_point now() const noexcept { return is_recording() ? clock::now() : clock::time_point(); }
+
+			void tasks_performed(size_t thread_index, size_t task_count, clock::time_point since) noexcept
+			{
+				if (is_recording())
+				{
+					threads[thread_index].tasks_performed += task_count;
+					threads[thread_index].time_in_tasks += clock::now() - since;
+				}
+			}
+
+			void idle(size_t thread_index, clock::time_point since) noexcept
+			{
+				if (is_recording())
+					threads[thread_index].time_idle += clock::now() - since;
+			}
+
+			void batch_started(size_t batch_index) noexcept
+			{
+				if (is_recording())
+				{
+					size_t started = batches_started.load(std::memory_order_relaxed);
+					while (started <= batch_index && !batches_started.compare_exchange_weak(started, batch_index + 1, std::memory_order_relaxed)) {}
+				}
+			}
+
+			// Called by the calling thread when it checks for batches to process. Every batch that has been
+			// started but not processed yet holds results. Only some of them may be complete.
+			void checking_for_batches(size_t batches_processed) noexcept
+			{
+				if (is_recording())
+				{
+					size_t const started = batches_started.load(std::memory_order_relaxed);
+					if (started > batches_processed)
+						peak_batches_buffered = std::max(peak_batches_buffered, started - batches_processed);
+				}
+			}
+
+			void batches_waiting(size_t batch_count) noexcept
+			{
+				if (is_recording())
+					peak_batches_waiting = std::max(peak_batches_waiting, batch_count);
+			}
+
+			void processed(clock::time_point since) noexcept
+			{
+				if (is_recording())
+					time_in_process += clock::now() - since;
+			}
+
+			void write(size_t batches_processed)
+			{
+				if (!is_recording())
+					return;
+
+				stats->threads.resize(threads.size());
+				for (size_t i = 0; i < threads.size(); ++i)
+				{
+					stats->threads[i].tasks_performed = threads[i].tasks_performed;
+					stats->threads[i].time_in_tasks = threads[i].time_in_tasks;
+					stats->threads[i].time_idle = threads[i].time_idle;
+				}
+				stats->time_in_process = time_in_process;
+				stats->batches_processed = batches_processed;
+				stats->peak_batches_waiting = peak_batches_waiting;
+				stats->peak_batches_buffered = peak_batches_buffered;
+			}
+
+		private:
+			// Each thread writes only to its own, so no atomics, but they are padded to avoid false sharing.
+			struct alignas(cache_line_size) ThreadStats
+			{
+				size_t tasks_performed = 0;
+				clock::duration time_in_tasks = clock::duration::zero();
+				clock::duration time_idle = clock::duration::zero();
+			};
+
+			BatchedParallelWorkStats * stats;
+			std::vector<ThreadStats> threads;
+			alignas(cache_line_size) std::atomic<size_t> batches_started = 0;
+			// Only touched by the calling thread.
+			alignas(cache_line_size) clock::duration time_in_process = clock::duration::zero();
+			size_t peak_batches_waiting = 0;
+			size_t peak_batches_buffered = 0;
+		};
+
+		// Claims and runs a range of tasks. Completion is published once per batch the range touches rather than once per task.
+		// If the storage can't take results for a batch yet, calls wait_for_batch with the index of the batch until it can.
+		// Returns the number of tasks performed, which is 0 when there was no work left to claim.
+		template <typename Work, typename Layout, typename Task, typename Scheduler, typename WaitForBatch>
+		size_t perform_task(Scheduler & scheduler, size_t worker_index, Layout & layout, Work & work, Task const & task, StatsCollector & stats, WaitForBatch && wait_for_batch)
+		{
+			size_t begin, end;
+			if (!scheduler.claim(worker_index, begin, end))
+				return 0;
+
+			size_t const claimed_begin = begin;
+			while (begin < end)
+			{
+				size_t const batch_index = layout.batch_of(begin);
+				size_t const batch_begin = layout.begin_of(batch_index);
+				size_t const batch_end = std::min(end, layout.end_of(batch_index));
+				while (!work.can_write_batch(batch_index))
+					wait_for_batch(batch_index);
+
+				stats.batch_started(batch_index);
+				auto const tasks_start = stats.now();
+				auto & batch = work.batch_at(batch_index, layout.max_batch_size());
+				auto * const results = batch.results();
+				for (size_t i = begin; i < batch_end; ++i)
+					::new (static_cast<void *>(results + (i - batch_begin))) typename Work::value_type(task(i));
+				batch.completed_work.fetch_add(batch_end - begin, std::memory_order_release);
+				stats.tasks_performed(worker_index, batch_end - begin, tasks_start);
+				begin = batch_end;
+			}
+			return end - claimed_begin;
 		}
 
-		template <typename T, typename Task>
-		void worker_thread(std::atomic<size_t> & index, size_t total_work, size_t batch_size, Work<T> & work, Task const & task)
+		template <typename Process, typename T>
+		BatchedParallelWorkFlow call_process(Process const & process, T results[], size_t result_count)
 		{
-			while (perform_task(index, total_work, batch_size, work, task)) {}
+			if constexpr (std::is_void_v<decltype(process(results, result_count))>)
+			{
+				process(results, result_count);
+				return BatchedParallelWorkFlow::keep_going;
+			}
+			else
+			{
+				return process(results, result_count);
+			}
 		}
 
-	} // namespace detail
+		template <typename Work, typename Layout, typename Task, typename Scheduler>
+		void worker_thread(Scheduler & scheduler, size_t worker_index, Layout & layout, Work & work, Task const & task, StatsCollector & stats)
+		{
+			auto const block = [&](size_t batch_index)
+			{
+				auto const wait_start = stats.now();
+				work.wait_until_can_write_batch(batch_index);
+				stats.idle(worker_index, wait_start);
+			};
+			while (perform_task(scheduler, worker_index, layout, work, task, stats, block)) {}
+		}
 
-	template <typename Task, typename Process, typename Executor>
-	void batched_parallel_work(size_t total_work, size_t batch_size, size_t worker_count, Task const & task, Process const & process, Executor && executor)
-	{
-		size_t const excedent = total_work % batch_size;
-		size_t const batch_count = total_work / batch_size;
+		template <typename Work, typename Scheduler, typename Layout, typename Task, typename Process, typename Executor>
+		BatchedParallelWorkProgress batched_parallel_work_impl(size_t total_work, Layout & layout, size_t worker_count, Task const & task, Process const & process, Executor && executor, BatchedParallelWorkOptions const & options, size_t batches_in_storage)
+		{
+			using clock = std::chrono::steady_clock;
 
-		using task_result_t = decltype(task(total_work));
-		detail::Work<task_result_t> work(batch_count + (excedent > 0));
+			Work work(batches_in_storage, layout.max_batch_size());
 
-		std::atomic<size_t> index = 0;
-		using worker_t = decltype(executor(detail::worker_thread<task_result_t, Task>, ref(index), total_work, batch_size, std::ref(work), std::ref(task)));
-		std::vector<worker_t> workers;
-		workers.reserve(worker_count);
-		for (size_t i = 0; i < worker_count; ++i)
-			workers.push_back(executor(detail::worker_thread<task_result_t, Task>, ref(index), total_work, batch_size, std::ref(work), std::ref(task)));
+			// The calling thread is worker 0.
+			Scheduler scheduler(total_work, worker_count + 1, std::max<size_t>(options.grain, 1));
+			constexpr size_t calling_thread = 0;
+			std::stop_callback const on_stop_requested(options.stop_token, [&scheduler]() noexcept { scheduler.request_stop(); });
+			StatsCollector stats(options.stats, worker_count + 1);
+			auto const worker_function = detail::worker_thread<Work, Layout, Task, Scheduler>;
+			using worker_t = decltype(executor(worker_function, std::ref(scheduler), size_t(1), std::ref(layout), std::ref(work), std::ref(task), std::ref(stats)));
+			std::vector<worker_t> workers;
+			workers.reserve(worker_count);
+			for (size_t i = 0; i < worker_count; ++i)
+				workers.push_back(executor(worker_function, std::ref(scheduler), i + 1, std::ref(layout), std::ref(work), std::ref(task), std::ref(stats)));
 
-		size_t batches_processed = 0;
-		while (batches_processed < batch_count)
-		{
-			detail::perform_task(index, total_work, batch_size, work, task);
-			while (batches_processed < batch_count && work.batches[batches_processed].completed_work == batch_size)
+			BatchSizeController batch_size_controller;
+			auto const update_target_batch_size = [&]()
+			{
+				if constexpr (Layout::adaptive)
+					if (size_t const size = batch_size_controller.batch_size(worker_count + 1, options.target_batch_duration))
+						layout.set_target_size(size);
+			};
+
+			// Batches before batches_processed, which end at processed_end, have either been processed or discarded.
+			size_t batches_processed = 0;
+			size_t processed_end = 0;
+			size_t processed_work = 0;
+			size_t batches_passed_to_process = 0;
+			// Only used for stats. Complete batches from the next one to process on.
+			auto const count_batches_waiting = [&]()
+			{
+				size_t count = 0;
+				for (size_t batch_begin = processed_end; batch_begin < total_work && count < batches_in_storage && layout.is_decided(batches_processed + count); ++count)
+				{
+					size_t const batch_end = layout.end_of(batches_processed + count);
+					if (work.batch_to_process(batches_processed + count).completed_work.load(std::memory_order_relaxed) != batch_end - batch_begin)
+						break;
+					batch_begin = batch_end;
+				}
+				return count;
+			};
+
+			auto const process_ready_batches = [&]()
+			{
+				size_t const processed_before = batches_processed;
+				stats.checking_for_batches(batches_processed);
+				if (stats.is_recording())
+					stats.batches_waiting(count_batches_waiting());
+				while (processed_end < total_work && layout.is_decided(batches_processed))
+				{
+					auto & batch = work.batch_to_process(batches_processed);
+					size_t const result_count = layout.end_of(batches_processed) - processed_end;
+					if (batch.completed_work.load(std::memory_order_acquire) != result_count)
+						break;
+
+					// After a stop, batches that complete are only freed, so that workers waiting for room in the window can finish.
+					if (!scheduler.stop_requested())
+					{
+						bool const time_process = Layout::adaptive || stats.is_recording();
+						auto const process_start = time_process ? clock::now() : clock::time_point();
+						BatchedParallelWorkFlow const flow = call_process(process, batch.results(), result_count);
+						if (time_process)
+						{
+							stats.processed(process_start);
+							if constexpr (Layout::adaptive)
+							{
+								batch_size_controller.batch_processed(result_count, clock::now() - process_start);
+								update_target_batch_size();
+							}
+						}
+
+						if (flow == BatchedParallelWorkFlow::stop)
+							scheduler.request_stop();
+						processed_work += result_count;
+						batches_passed_to_process++;
+					}
+					std::destroy_n(batch.results(), result_count);
+					work.free_batch(batches_processed);
+					batches_processed++;
+					processed_end += result_count;
+				}
+				return batches_processed != processed_before;
+			};
+
+			auto const yield_calling_thread = [&]()
+			{
+				auto const yield_start = stats.now();
+				std::this_thread::yield();
+				stats.idle(calling_thread, yield_start);
+			};
+
+			// The calling thread must never block on a full window, since it's the one that empties it.
+			clock::duration time_spent_waiting = clock::duration::zero();
+			auto const process_while_waiting = [&](size_t /*batch_index*/)
+			{
+				if constexpr (Layout::adaptive)
+				{
+					auto const wait_start = clock::now();
+					if (!process_ready_batches())
+						yield_calling_thread();
+					time_spent_waiting += clock::now() - wait_start;
+				}
+				else
+				{
+					if (!process_ready_batches())
+						yield_calling_thread();
+				}
+			};
+
+			// With adaptive batches, the tasks run by the calling thread are timed, leaving out the time it spends
+			// processing batches while it waits for room in the window.
+			auto const perform_task_on_calling_thread = [&]()
 			{
-				process(work.batches[batches_processed].results.get(), batch_size);
-				work.free_batch(batches_processed);
-				batches_processed++;
+				if constexpr (Layout::adaptive)
+				{
+					time_spent_waiting = clock::duration::zero();
+					auto const tasks_start = clock::now();
+					size_t const tasks_performed = detail::perform_task(scheduler, calling_thread, layout, work, task, stats, process_while_waiting);
+					if (tasks_performed > 0)
+					{
+						batch_size_controller.tasks_performed(tasks_performed, clock::now() - tasks_start - time_spent_waiting);
+						update_target_batch_size();
+					}
+					return tasks_performed;
+				}
+				else
+				{
+					return detail::perform_task(scheduler, calling_thread, layout, work, task, stats, process_while_waiting);
+				}
+			};
+
+			while (processed_end < total_work && !scheduler.stop_requested())
+			{
+				size_t const tasks_performed = perform_task_on_calling_thread();
+
+				if (!process_ready_batches() && tasks_performed == 0)
+					yield_calling_thread();
 			}
+
+			if (processed_end < total_work)
+			{
+				scheduler.stop_claiming();
+
+				// Workers may be waiting for room in the window for tasks they have already claimed. Wait for the
+				// claimed tasks of every batch and free it, until the first batch that nobody claimed any task of.
+				if constexpr (Work::bounded)
+				{
+					for (; processed_end < total_work && scheduler.was_claimed(processed_end); ++batches_processed)
+					{
+						// Whoever claimed the first task of the batch decides its size, if it hasn't been decided yet.
+						while (!layout.is_decided(batches_processed))
+							std::this_thread::yield();
+
+						size_t const batch_end = layout.end_of(batches_processed);
+						size_t claimed_end = processed_end;
+						while (claimed_end < batch_end && scheduler.was_claimed(claimed_end))
+							claimed_end++;
+
+						auto & batch = work.batch_to_process(batches_processed);
+						while (batch.completed_work.load(std::memory_order_acquire) != claimed_end - processed_end)
+							std::this_thread::yield();
+						std::destroy_n(batch.results(), claimed_end - processed_end);
+						work.free_batch(batches_processed);
+						processed_end = batch_end;
+					}
+				}
+			}
+
+			for (worker_t & t : workers)
+				t.join();
+
+			// Destroy the results that were computed but never processed. Batches may have holes where no task was claimed.
+			if constexpr (!std::is_trivially_destructible_v<typename Work::value_type>)
+			{
+				for (size_t i = batches_processed; i < layout.max_batch_count() && layout.is_decided(i); ++i)
+				{
+					auto & batch = work.batch_to_process(i);
+					if (batch.completed_work.load(std::memory_order_relaxed) == 0)
+						continue;
+
+					size_t const batch_begin = layout.begin_of(i);
+					for (size_t j = batch_begin; j < layout.end_of(i); ++j)
+						if (scheduler.was_claimed(j))
+							std::destroy_at(batch.results() + (j - batch_begin));
+				}
+			}
+
+			stats.write(batches_passed_to_process);
+
+			BatchedParallelWorkProgress progress;
+			progress.processed_work = processed_work;
+			progress.stopped = processed_work < total_work;
+			if constexpr (Layout::adaptive)
+				progress.batch_sizes = layout.sizes_of_first_batches(batches_passed_to_process);
+			return progress;
 		}
 
-		// Last batch, which is smaller and so has to be treated differently.
-		if (excedent > 0)
+		template <typename Work, typename Layout, typename Task, typename Process, typename Executor>
+		BatchedParallelWorkProgress batched_parallel_work_with_storage(size_t total_work, Layout & layout, size_t worker_count, Task const & task, Process const & process, Executor && executor, BatchedParallelWorkOptions const & options, size_t batches_in_storage)
 		{
-			detail::Batch<task_result_t> & last_batch = work.batches.back();
-			while (last_batch.completed_work != excedent)
-				detail::perform_task(index, total_work, batch_size, work, task);
+			// A full window would block workers on their own slices, and adaptive batches are decided in order,
+			// so both take indices in order.
+			if constexpr (!Work::bounded && !Layout::adaptive)
+			{
+				bool const work_stealing = options.scheduling == BatchedParallelWorkScheduling::work_stealing
+					&& options.max_batches_in_flight == 0
+					&& total_work <= WorkStealingScheduler::max_total_work;
+
+				if (work_stealing)
+					return batched_parallel_work_impl<Work, WorkStealingScheduler>(total_work, layout, worker_count, task, process, executor, options, batches_in_storage);
+			}
+
+			return batched_parallel_work_impl<Work, SharedIndexScheduler>(total_work, layout, worker_count, task, process, executor, options, batches_in_storage);
+		}
 
-			process(last_batch.results.get(), excedent);
+		template <typename T, typename Layout, typename Task, typename Process, typename Executor>
+		BatchedParallelWorkProgress batched_parallel_work_with_layout(size_t total_work, Layout & layout, size_t worker_count, Task const & task, Process const & process, Executor && executor, BatchedParallelWorkOptions const & options)
+		{
+			size_t const batch_count = layout.max_batch_count();
+			if (options.max_batches_in_flight > 0 && options.max_batches_in_flight < batch_count)
+				return batched_parallel_work_with_storage<WindowedWork<T>>(total_work, layout, worker_count, task, process, executor, options, options.max_batches_in_flight);
+			else
+				return batched_parallel_work_with_storage<Work<T>>(total_work, layout, worker_count, task, process, executor, options, batch_count);
 		}
 
-		for (worker_t & t : workers)
-			t.join();
+	} // namespace detail
+
+	template <typename Task, typename Process, typename Executor>
+	BatchedParallelWorkProgress batched_parallel_work(size_t total_work, size_t batch_size, size_t worker_count, Task const & task, Process const & process, Executor && executor, BatchedParallelWorkOptions const & options)
+	{
+		using task_result_t = decltype(task(total_work));
+
+		if (options.max_batch_size > batch_size)
+		{
+			detail::AdaptiveBatches layout(total_work, batch_size, options.max_batch_size);
+			return detail::batched_parallel_work_with_layout<task_result_t>(total_work, layout, worker_count, task, process, executor, options);
+		}
+		else
+		{
+			detail::FixedBatches layout(total_work, batch_size);
+			return detail::batched_parallel_work_with_layout<task_result_t>(total_work, layout, worker_count, task, process, executor, options);
+		}
 	}
 
 } // namespace aeh
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "batched_parallel_work.hh"
+#include "thread_pool.hh"
+#include <coroutine>
+#include <span>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		template <typename Task>
+		struct BatchedParallelWorkStreamState;
+	} // namespace detail
+
+	// Awaitable counterpart of batched_parallel_work for coroutines. Tasks run on a thread pool and results are consumed
+	// in order by awaiting next(). A coroutine that awaits a batch that isn't complete yet is suspended and then resumed
+	// by the pool thread that completes the batch, so no thread sits blocked waiting for results. Unlike in
+	// batched_parallel_work, the calling thread doesn't run tasks, so worker_count and the pool must be at least 1.
+	//
+	// Results are kept in a window of max_batches_in_flight batches, or twice worker_count if that is 0, and workers that
+	// get too far ahead wait for the consumer to catch up. grain is rounded down to a divisor of batch_size. Other
+	// options don't apply to streams.
+	// Destroying the stream before all batches have been consumed stops the job: tasks that are already running finish,
+	// their results are destroyed, and the destructor waits for the workers that started to leave. Workers still queued
+	// on the pool don't run any task when they start, so the stream can be destroyed from a pool thread even if the pool
+	// has fewer threads than workers.
+	template <typename Task>
+	struct BatchedParallelWorkStream
+	{
+		using value_type = decltype(std::declval<Task const &>()(size_t()));
+
+		BatchedParallelWorkStream(
+			size_t total_work, size_t batch_size, size_t worker_count,
+			Task task, ThreadPool & pool,
+			BatchedParallelWorkOptions const & options = BatchedParallelWorkOptions());
+		BatchedParallelWorkStream(BatchedParallelWorkStream const &) = delete;
+		BatchedParallelWorkStream(BatchedParallelWorkStream &&) = delete;
+		auto operator = (BatchedParallelWorkStream const &) -> BatchedParallelWorkStream & = delete;
+		auto operator = (BatchedParallelWorkStream &&) -> BatchedParallelWorkStream & = delete;
+		~BatchedParallelWorkStream();
+
+		struct NextBatch
+		{
+			[[nodiscard]] auto await_ready() const noexcept -> bool;
+			auto await_suspend(std::coroutine_handle<> awaiting) const noexcept -> bool;
+			auto await_resume() const noexcept -> std::span<value_type>;
+
+			BatchedParallelWorkStream * stream;
+		};
+
+		// Awaits the results of the next batch, in order. An empty span means that there are no batches left.
+		// Invalidates the span of the previous batch, since its results are destroyed to make room for later batches.
+		[[nodiscard]] auto next() -> NextBatch;
+
+	private:
+		auto release_held_batch() noexcept -> void;
+
+		std::shared_ptr<detail::BatchedParallelWorkStreamState<Task>> state;
+		// Index of the batch the consumer is awaiting or holding.
+		size_t next_batch = 0;
+		bool holding_batch = false;
+	};
+
+	template <typename Task>
+	[[nodiscard]] auto batched_parallel_work_stream(
+		size_t total_work, size_t batch_size, size_t worker_count,
+		Task task, ThreadPool & pool,
+		BatchedParallelWorkOptions const & options = BatchedParallelWorkOptions()) -> BatchedParallelWorkStream<Task>;
+
+} // namespace aeh
+
+#include "batched_parallel_work_stream.inl"
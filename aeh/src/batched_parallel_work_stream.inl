@@ -0,0 +1,205 @@
+#include <numeric>
+#include <utility>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		// Set while a pool thread resumes the consumer of a stream, so that if the consumer destroys the stream
+		// from there, the destructor doesn't wait for the very thread it's running on to leave.
+		inline thread_local void const * stream_being_resumed = nullptr;
+
+		// Shared between the stream and its workers, so that it lives until the last worker leaves.
+		template <typename Task>
+		struct BatchedParallelWorkStreamState
+		{
+			using value_type = decltype(std::declval<Task const &>()(size_t()));
+
+			BatchedParallelWorkStreamState(size_t total_work, size_t batch_size, size_t worker_count, Task && task_, size_t window_size, size_t grain)
+				: task(std::move(task_))
+				, layout(total_work, batch_size)
+				, work(window_size, batch_size)
+				, scheduler(total_work, worker_count, grain)
+				, stats(nullptr, 0)
+			{}
+
+			static void run_worker(std::shared_ptr<BatchedParallelWorkStreamState> const & self, size_t worker_index) noexcept
+			{
+				// Workers only count from when they start, since the stream may be destroyed by the very pool thread that
+				// a queued worker is waiting for. Workers that start after that have nothing to do. Both this and the
+				// destructor write one flag and then read the other, so at least one of them sees the other's write.
+				self->active_workers.fetch_add(1, std::memory_order_seq_cst);
+				if (self->stopped.load(std::memory_order_seq_cst))
+				{
+					self->leave();
+					return;
+				}
+
+				// Claimed ranges never span more than one batch, so every batch is completed at the end of some
+				// perform_task. The consumer is only resumed from here, where this thread holds no claimed tasks,
+				// because the consumer may destroy the stream, and that waits for claimed tasks to finish.
+				auto const block = [&self](size_t batch_index) { self->work.wait_until_can_write_batch(batch_index); };
+				while (perform_task(self->scheduler, worker_index, self->layout, self->work, self->task, self->stats, block))
+					self->resume_consumer_if_ready();
+
+				self->leave();
+			}
+
+			void leave() noexcept
+			{
+				active_workers.fetch_sub(1, std::memory_order_release);
+				active_workers.notify_all();
+			}
+
+			bool is_complete(size_t batch_index) noexcept
+			{
+				if (batch_index >= layout.max_batch_count())
+					return true;
+				size_t const batch_size = layout.end_of(batch_index) - layout.begin_of(batch_index);
+				return work.batch_to_process(batch_index).completed_work.load(std::memory_order_acquire) == batch_size;
+			}
+
+			// Workers call this after completing tasks. Whoever takes the handle out of waiting_consumer resumes it.
+			void resume_consumer_if_ready() noexcept
+			{
+				void * address = waiting_consumer.load(std::memory_order_acquire);
+				if (address == nullptr || !is_complete(awaited_batch.load(std::memory_order_relaxed)))
+					return;
+				if (!waiting_consumer.compare_exchange_strong(address, nullptr, std::memory_order_acq_rel))
+					return;
+
+				void const * const previous = std::exchange(stream_being_resumed, this);
+				std::coroutine_handle<>::from_address(address).resume();
+				stream_being_resumed = previous;
+			}
+
+			void release_batch(size_t batch_index, size_t result_count) noexcept
+			{
+				std::destroy_n(work.batch_to_process(batch_index).results(), result_count);
+				work.free_batch(batch_index);
+			}
+
+			Task task;
+			FixedBatches layout;
+			WindowedWork<value_type> work;
+			SharedIndexScheduler scheduler;
+			StatsCollector stats;
+			alignas(cache_line_size) std::atomic<size_t> active_workers = 0;
+			std::atomic<bool> stopped = false;
+			alignas(cache_line_size) std::atomic<void *> waiting_consumer = nullptr;
+			std::atomic<size_t> awaited_batch = 0;
+		};
+	} // namespace detail
+
+	template <typename Task>
+	BatchedParallelWorkStream<Task>::BatchedParallelWorkStream(size_t total_work, size_t batch_size, size_t worker_count, Task task, ThreadPool & pool, BatchedParallelWorkOptions const & options)
+	{
+		debug_assert_msg(worker_count > 0 && pool.thread_count() > 0, "The calling thread doesn't run tasks of a stream, so there must be workers");
+
+		size_t const batch_count = total_work / batch_size + (total_work % batch_size > 0);
+		size_t const window_size = options.max_batches_in_flight > 0 ? options.max_batches_in_flight : 2 * worker_count;
+
+		// A grain that divides the batch size keeps claimed ranges from spanning two batches.
+		size_t const grain = std::gcd(std::max<size_t>(options.grain, 1), batch_size);
+
+		using state_t = detail::BatchedParallelWorkStreamState<Task>;
+		state = std::make_shared<state_t>(total_work, batch_size, worker_count, std::move(task),
+			std::clamp<size_t>(window_size, 1, std::max<size_t>(batch_count, 1)), grain);
+
+		for (size_t i = 0; i < worker_count; ++i)
+			pool.post([state = state, i]() noexcept { state_t::run_worker(state, i); });
+	}
+
+	template <typename Task>
+	BatchedParallelWorkStream<Task>::~BatchedParallelWorkStream()
+	{
+		state->waiting_consumer.store(nullptr, std::memory_order_relaxed);
+		release_held_batch();
+
+		// Same as when batched_parallel_work stops: wait for the tasks that were already claimed, and free their
+		// batches so that workers waiting for room in the window can finish.
+		auto & scheduler = state->scheduler;
+		auto & layout = state->layout;
+		scheduler.stop_claiming();
+		state->stopped.store(true, std::memory_order_seq_cst);
+		for (; next_batch < layout.max_batch_count() && scheduler.was_claimed(layout.begin_of(next_batch)); ++next_batch)
+		{
+			size_t const batch_begin = layout.begin_of(next_batch);
+			size_t claimed_end = batch_begin;
+			while (claimed_end < layout.end_of(next_batch) && scheduler.was_claimed(claimed_end))
+				claimed_end++;
+
+			auto & batch = state->work.batch_to_process(next_batch);
+			while (batch.completed_work.load(std::memory_order_acquire) != claimed_end - batch_begin)
+				std::this_thread::yield();
+			state->release_batch(next_batch, claimed_end - batch_begin);
+		}
+
+		size_t const this_thread_is_a_worker = detail::stream_being_resumed == state.get() ? 1 : 0;
+		for (size_t active = state->active_workers.load(std::memory_order_seq_cst); active != this_thread_is_a_worker; active = state->active_workers.load(std::memory_order_acquire))
+			state->active_workers.wait(active, std::memory_order_acquire);
+	}
+
+	template <typename Task>
+	auto BatchedParallelWorkStream<Task>::next() -> NextBatch
+	{
+		release_held_batch();
+		return NextBatch{this};
+	}
+
+	template <typename Task>
+	auto BatchedParallelWorkStream<Task>::release_held_batch() noexcept -> void
+	{
+		if (!holding_batch)
+			return;
+
+		auto const & layout = state->layout;
+		state->release_batch(next_batch, layout.end_of(next_batch) - layout.begin_of(next_batch));
+		next_batch++;
+		holding_batch = false;
+	}
+
+	template <typename Task>
+	auto BatchedParallelWorkStream<Task>::NextBatch::await_ready() const noexcept -> bool
+	{
+		return stream->state->is_complete(stream->next_batch);
+	}
+
+	template <typename Task>
+	auto BatchedParallelWorkStream<Task>::NextBatch::await_suspend(std::coroutine_handle<> awaiting) const noexcept -> bool
+	{
+		auto & state = *stream->state;
+		size_t const batch_index = stream->next_batch;
+		state.awaited_batch.store(batch_index, std::memory_order_relaxed);
+		state.waiting_consumer.store(awaiting.address(), std::memory_order_release);
+
+		// The batch may have been completed before the handle was visible to workers. If no worker took the handle
+		// to resume it in the meantime, don't suspend at all. Otherwise the coroutine may be running on another
+		// thread already, so nothing here can be touched anymore.
+		if (!state.is_complete(batch_index))
+			return true;
+		void * expected = awaiting.address();
+		return !state.waiting_consumer.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+	}
+
+	template <typename Task>
+	auto BatchedParallelWorkStream<Task>::NextBatch::await_resume() const noexcept -> std::span<value_type>
+	{
+		auto & state = *stream->state;
+		size_t const batch_index = stream->next_batch;
+		if (batch_index >= state.layout.max_batch_count())
+			return {};
+
+		stream->holding_batch = true;
+		size_t const result_count = state.layout.end_of(batch_index) - state.layout.begin_of(batch_index);
+		return std::span<value_type>(state.work.batch_to_process(batch_index).results(), result_count);
+	}
+
+	template <typename Task>
+	auto batched_parallel_work_stream(size_t total_work, size_t batch_size, size_t worker_count, Task task, ThreadPool & pool, BatchedParallelWorkOptions const & options) -> BatchedParallelWorkStream<Task>
+	{
+		return BatchedParallelWorkStream<Task>(total_work, batch_size, worker_count, std::move(task), pool, options);
+	}
+
+} // namespace aeh
@@ -0,0 +1,89 @@
+#include "byte_ring.hh"
+#include "debug/assert.hh"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace aeh
+{
+
+	byte_ring::byte_ring(size_t min_capacity) noexcept
+		: memory(MirroredMemoryRegion::map_bytes_of_mirrored_memory(min_capacity))
+	{
+		debug_assert_msg(min_capacity == 0 || memory.memory_region_address() != nullptr, "Could not map memory for byte_ring");
+	}
+
+	byte_ring::byte_ring(byte_ring && other) noexcept
+		: memory(std::move(other.memory))
+		, first_(std::exchange(other.first_, 0))
+		, size_(std::exchange(other.size_, 0))
+	{}
+
+	auto byte_ring::operator = (byte_ring && other) noexcept -> byte_ring &
+	{
+		memory = std::move(other.memory);
+		first_ = std::exchange(other.first_, 0);
+		size_ = std::exchange(other.size_, 0);
+		return *this;
+	}
+
+	auto byte_ring::readable() noexcept -> std::span<std::byte>
+	{
+		return std::span<std::byte>(buffer() + first_, size_);
+	}
+
+	auto byte_ring::readable() const noexcept -> std::span<std::byte const>
+	{
+		return std::span<std::byte const>(buffer() + first_, size_);
+	}
+
+	auto byte_ring::writable() noexcept -> std::span<std::byte>
+	{
+		// first_ + size_ may be past the end of the first copy, but never past the end of the second.
+		return std::span<std::byte>(buffer() + first_ + size_, free_space());
+	}
+
+	auto byte_ring::commit_write(size_t n) noexcept -> void
+	{
+		debug_assert(n <= free_space());
+		size_ += n;
+	}
+
+	auto byte_ring::consume(size_t n) noexcept -> void
+	{
+		debug_assert(n <= size_);
+		size_ -= n;
+		first_ += n;
+		if (first_ >= capacity())
+			first_ -= capacity();
+
+		// Starting over from the beginning when empty keeps later writes inside the pages that were just touched.
+		if (size_ == 0)
+			first_ = 0;
+	}
+
+	auto byte_ring::write(std::span<std::byte const> bytes) noexcept -> size_t
+	{
+		size_t const n = std::min(bytes.size(), free_space());
+		if (n > 0)
+			std::memcpy(writable().data(), bytes.data(), n);
+		commit_write(n);
+		return n;
+	}
+
+	auto byte_ring::read(std::span<std::byte> bytes) noexcept -> size_t
+	{
+		size_t const n = std::min(bytes.size(), size_);
+		if (n > 0)
+			std::memcpy(bytes.data(), readable().data(), n);
+		consume(n);
+		return n;
+	}
+
+	auto byte_ring::clear() noexcept -> void
+	{
+		first_ = 0;
+		size_ = 0;
+	}
+
+} // namespace aeh
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "virtual_memory.hh"
+#include <cstddef>
+#include <span>
+
+namespace aeh
+{
+
+	// FIFO of bytes for streaming data. Unlike ring, whose contents may wrap around the end of its buffer, the buffer of
+	// a byte_ring is mapped twice in a row, so the readable and writable parts are always one contiguous span each.
+	// Producers write into writable() and then call commit_write, and parsers look at readable() in place and call
+	// consume for whatever they are done with, without having to care about wraparound or copy anything.
+	// Capacity is fixed at construction and rounded up to mirrored_memory_granularity. Not thread safe.
+	struct byte_ring
+	{
+		byte_ring() noexcept = default;
+		explicit byte_ring(size_t min_capacity) noexcept;
+
+		byte_ring(byte_ring const &) = delete;
+		byte_ring(byte_ring && other) noexcept;
+		auto operator = (byte_ring const &) -> byte_ring & = delete;
+		auto operator = (byte_ring && other) noexcept -> byte_ring &;
+
+		[[nodiscard]] auto empty() const noexcept -> bool { return size_ == 0; }
+		[[nodiscard]] auto full() const noexcept -> bool { return size_ == capacity(); }
+		[[nodiscard]] auto size() const noexcept -> size_t { return size_; }
+		[[nodiscard]] auto capacity() const noexcept -> size_t { return memory.size_in_bytes(); }
+		[[nodiscard]] auto free_space() const noexcept -> size_t { return capacity() - size_; }
+
+		// Bytes written and not consumed yet, oldest first.
+		[[nodiscard]] auto readable() noexcept -> std::span<std::byte>;
+		[[nodiscard]] auto readable() const noexcept -> std::span<std::byte const>;
+		// Free space after the last written byte. Filling part of it and then calling commit_write appends those bytes.
+		[[nodiscard]] auto writable() noexcept -> std::span<std::byte>;
+
+		// Appends the first n bytes of writable().
+		auto commit_write(size_t n) noexcept -> void;
+		// Drops the first n bytes of readable().
+		auto consume(size_t n) noexcept -> void;
+
+		// Copy as many bytes as fit or as there are, and return how many that was.
+		auto write(std::span<std::byte const> bytes) noexcept -> size_t;
+		auto read(std::span<std::byte> bytes) noexcept -> size_t;
+
+		auto clear() noexcept -> void;
+
+	private:
+		[[nodiscard]] auto buffer() const noexcept -> std::byte * { return static_cast<std::byte *>(memory.memory_region_address()); }
+
+		MirroredMemoryRegion memory;
+		// Offset of the oldest byte, always in the first copy of the buffer.
+		size_t first_ = 0;
+		size_t size_ = 0;
+	};
+
+} // namespace aeh
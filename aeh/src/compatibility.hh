@@ -192,3 +192,10 @@
 #else
 #	define AEH_FORCEINLINE inline
 #endif
+
+// MSVC accepts [[no_unique_address]] but ignores it, so empty members still take space. Its own spelling works.
+#if AEH_MSVC
+#	define AEH_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#	define AEH_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
@@ -336,7 +336,7 @@ namespace aeh
 		-> void
 		requires(std::is_constructible_v<T, std::iter_value_t<It>>)
 	{
-		debug_assert(std::distance(first, last) <= Capacity);
+		debug_assert(static_cast<size_t>(std::distance(first, last)) <= Capacity);
 		clear();
 		for (It it = first; it != last; ++it)
 			emplace_back(*it);
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "flat_set.hh" // flat_lower_bound
+#include "debug/assert.hh"
+#include <compare>
+#include <tuple>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		// Iterates keys and values in step. Dereferencing gives a pair of references, like std::flat_map's iterators.
+		template <typename Key, typename Value>
+		struct FlatMapIterator
+		{
+			using iterator_concept = std::random_access_iterator_tag;
+			using iterator_category = std::input_iterator_tag;
+			using difference_type = ptrdiff_t;
+			using value_type = std::pair<Key, std::remove_const_t<Value>>;
+			using reference = std::pair<Key const &, Value &>;
+
+			struct pointer
+			{
+				reference ref;
+				auto operator -> () noexcept -> reference * { return &ref; }
+			};
+
+			FlatMapIterator() noexcept = default;
+			FlatMapIterator(Key const * key_, Value * value_) noexcept : key(key_), value(value_) {}
+			// Non-const to const conversion.
+			template <typename OtherValue> requires std::is_same_v<Value, OtherValue const>
+			FlatMapIterator(FlatMapIterator<Key, OtherValue> other) noexcept : key(other.key), value(other.value) {}
+
+			[[nodiscard]] auto operator * () const noexcept -> reference { return {*key, *value}; }
+			[[nodiscard]] auto operator -> () const noexcept -> pointer { return {**this}; }
+			[[nodiscard]] auto operator [] (difference_type n) const noexcept -> reference { return {key[n], value[n]}; }
+
+			auto operator ++ () noexcept -> FlatMapIterator & { ++key; ++value; return *this; }
+			auto operator -- () noexcept -> FlatMapIterator & { --key; --value; return *this; }
+			auto operator ++ (int) noexcept -> FlatMapIterator { FlatMapIterator const old = *this; ++*this; return old; }
+			auto operator -- (int) noexcept -> FlatMapIterator { FlatMapIterator const old = *this; --*this; return old; }
+			auto operator += (difference_type n) noexcept -> FlatMapIterator & { key += n; value += n; return *this; }
+			auto operator -= (difference_type n) noexcept -> FlatMapIterator & { key -= n; value -= n; return *this; }
+
+			[[nodiscard]] friend auto operator + (FlatMapIterator it, difference_type n) noexcept -> FlatMapIterator { return it += n; }
+			[[nodiscard]] friend auto operator + (difference_type n, FlatMapIterator it) noexcept -> FlatMapIterator { return it += n; }
+			[[nodiscard]] friend auto operator - (FlatMapIterator it, difference_type n) noexcept -> FlatMapIterator { return it -= n; }
+			[[nodiscard]] friend auto operator - (FlatMapIterator a, FlatMapIterator b) noexcept -> difference_type { return a.key - b.key; }
+			[[nodiscard]] friend auto operator == (FlatMapIterator a, FlatMapIterator b) noexcept -> bool { return a.key == b.key; }
+			[[nodiscard]] friend auto operator <=> (FlatMapIterator a, FlatMapIterator b) noexcept -> std::strong_ordering { return a.key <=> b.key; }
+
+			Key const * key = nullptr;
+			Value * value = nullptr;
+		};
+	} // namespace detail
+
+	// Map stored as a sorted array of keys and a separate array of values in the same order, for small, read-mostly
+	// lookup tables where std::map's nodes scattered over the heap are slow to search. Searching only touches keys,
+	// so they pack densely in cache. The containers are any contiguous containers with emplace_back and erase, such as
+	// std::vector or fixed_capacity_vector. Same as flat_set, build it with the constructor or the range version of
+	// insert, which sort once, rather than inserting pairs one at a time. Iterators are invalidated by any insertion
+	// or erasure.
+	template <typename Key, typename Value, typename Compare = std::less<Key>,
+		typename KeyContainer = std::vector<Key>, typename ValueContainer = std::vector<Value>>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	struct flat_map
+	{
+		using key_type = Key;
+		using mapped_type = Value;
+		using value_type = std::pair<Key, Value>;
+		using key_compare = Compare;
+		using key_container_type = KeyContainer;
+		using mapped_container_type = ValueContainer;
+		using size_type = size_t;
+		using iterator = detail::FlatMapIterator<Key, Value>;
+		using const_iterator = detail::FlatMapIterator<Key, Value const>;
+
+		flat_map() noexcept(std::is_nothrow_default_constructible_v<KeyContainer> && std::is_nothrow_default_constructible_v<ValueContainer>) = default;
+		// keys[i] maps to values[i]. Sorts them by key and removes duplicate keys, keeping the first of each.
+		flat_map(KeyContainer keys, ValueContainer values, Compare compare = Compare());
+		flat_map(std::initializer_list<value_type> ilist, Compare compare = Compare());
+
+		[[nodiscard]] auto size() const noexcept -> size_t { return keys_.size(); }
+		[[nodiscard]] auto empty() const noexcept -> bool { return keys_.empty(); }
+		[[nodiscard]] auto begin() noexcept -> iterator { return iterator(std::ranges::data(keys_), std::ranges::data(values_)); }
+		[[nodiscard]] auto end() noexcept -> iterator { return begin() + ssize(); }
+		[[nodiscard]] auto begin() const noexcept -> const_iterator { return const_iterator(std::ranges::data(keys_), std::ranges::data(values_)); }
+		[[nodiscard]] auto end() const noexcept -> const_iterator { return begin() + ssize(); }
+		[[nodiscard]] auto keys() const noexcept -> std::span<Key const> { return keys_; }
+		[[nodiscard]] auto values() noexcept -> std::span<Value> { return values_; }
+		[[nodiscard]] auto values() const noexcept -> std::span<Value const> { return values_; }
+		[[nodiscard]] auto key_comp() const noexcept -> Compare { return compare_; }
+		auto clear() noexcept -> void { keys_.clear(); values_.clear(); }
+
+		[[nodiscard]] auto lower_bound(Key const & key) -> iterator;
+		[[nodiscard]] auto lower_bound(Key const & key) const -> const_iterator;
+		[[nodiscard]] auto find(Key const & key) -> iterator;
+		[[nodiscard]] auto find(Key const & key) const -> const_iterator;
+		[[nodiscard]] auto contains(Key const & key) const -> bool;
+		[[nodiscard]] auto count(Key const & key) const -> size_t;
+		// Inserts a default constructed value if the key isn't in the map.
+		[[nodiscard]] auto operator [] (Key const & key) -> Value & requires(std::is_default_constructible_v<Value>);
+
+		// Linear in size, since elements after the new one are moved. Does nothing if the key is already in the map.
+		auto insert(Key key, Value value) -> std::pair<iterator, bool>;
+		auto insert_or_assign(Key key, Value value) -> std::pair<iterator, bool>;
+		// Appends the pairs and sorts them into place all at once. Keys already in the map keep their values and are
+		// skipped. Keys that appear more than once in the range all take room until the sort removes the duplicates,
+		// keeping the first, which containers of fixed capacity must have.
+		template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+		auto insert(It first, Sentinel last) -> void;
+		template <std::ranges::input_range R>
+		auto insert_range(R && range) -> void;
+
+		auto erase(const_iterator pos) -> iterator;
+		auto erase(Key const & key) -> size_t;
+
+	private:
+		[[nodiscard]] auto ssize() const noexcept -> ptrdiff_t { return static_cast<ptrdiff_t>(keys_.size()); }
+		[[nodiscard]] auto index_of_lower_bound(Key const & key) const -> size_t;
+		auto insert_at(size_t index, Key && key, Value && value) -> iterator;
+		// Whether key is one of the first count keys, which are sorted.
+		[[nodiscard]] auto is_in_first(size_t count, Key const & key) const -> bool;
+		// Sorts pairs from sorted_count onwards and merges them with the first sorted_count, which are already sorted.
+		auto sort_and_remove_duplicates(size_t sorted_count) -> void;
+
+		KeyContainer keys_;
+		ValueContainer values_;
+		[[no_unique_address]] Compare compare_;
+	};
+
+} // namespace aeh
+
+#include "flat_map.inl"
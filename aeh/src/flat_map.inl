@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <utility>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		// Sorting and merging keys and values in step, without allocating, so that maps backed by containers of fixed
+		// capacity don't allocate either. All of them are stable.
+
+		template <typename Key, typename Value>
+		auto rotate_by_key(Key * keys, Value * values, size_t first, size_t middle, size_t last) -> void
+		{
+			std::rotate(keys + first, keys + middle, keys + last);
+			std::rotate(values + first, values + middle, values + last);
+		}
+
+		template <typename Key, typename Value, typename Compare>
+		auto insertion_sort_by_key(Key * keys, Value * values, size_t first, size_t last, Compare const & compare) -> void
+		{
+			for (size_t i = first + 1; i < last; ++i)
+			{
+				size_t const position = static_cast<size_t>(std::upper_bound(keys + first, keys + i, keys[i], compare) - keys);
+				rotate_by_key(keys, values, position, i, i + 1);
+			}
+		}
+
+		// Same as std::inplace_merge when it can't get a buffer. Rotates the first half of the larger run past the
+		// elements of the other run that go before it, and merges both sides of the rotation recursively.
+		template <typename Key, typename Value, typename Compare>
+		auto merge_by_key(Key * keys, Value * values, size_t first, size_t middle, size_t last, Compare const & compare) -> void
+		{
+			size_t const length1 = middle - first;
+			size_t const length2 = last - middle;
+			if (length1 == 0 || length2 == 0)
+				return;
+
+			if (length1 + length2 == 2)
+			{
+				if (compare(keys[middle], keys[first]))
+				{
+					std::swap(keys[first], keys[middle]);
+					std::swap(values[first], values[middle]);
+				}
+				return;
+			}
+
+			size_t cut1;
+			size_t cut2;
+			if (length1 > length2)
+			{
+				cut1 = first + length1 / 2;
+				cut2 = static_cast<size_t>(std::lower_bound(keys + middle, keys + last, keys[cut1], compare) - keys);
+			}
+			else
+			{
+				cut2 = middle + length2 / 2;
+				cut1 = static_cast<size_t>(std::upper_bound(keys + first, keys + middle, keys[cut2], compare) - keys);
+			}
+
+			rotate_by_key(keys, values, cut1, middle, cut2);
+			size_t const new_middle = cut1 + (cut2 - middle);
+			merge_by_key(keys, values, first, cut1, new_middle, compare);
+			merge_by_key(keys, values, new_middle, cut2, last, compare);
+		}
+
+		// Bottom up merge sort over short runs sorted by insertion.
+		template <typename Key, typename Value, typename Compare>
+		auto stable_sort_by_key(Key * keys, Value * values, size_t first, size_t last, Compare const & compare) -> void
+		{
+			constexpr size_t run_length = 16;
+			for (size_t run = first; run < last; run += run_length)
+				insertion_sort_by_key(keys, values, run, std::min(run + run_length, last), compare);
+
+			for (size_t width = run_length; width < last - first; width *= 2)
+				for (size_t run = first; run + width < last; run += 2 * width)
+					merge_by_key(keys, values, run, run + width, std::min(run + 2 * width, last), compare);
+		}
+	} // namespace detail
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::flat_map(KeyContainer keys, ValueContainer values, Compare compare)
+		: keys_(std::move(keys))
+		, values_(std::move(values))
+		, compare_(std::move(compare))
+	{
+		debug_assert_msg(std::ranges::size(keys_) == std::ranges::size(values_), "Every key needs a value");
+		sort_and_remove_duplicates(0);
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::flat_map(std::initializer_list<value_type> ilist, Compare compare)
+		: compare_(std::move(compare))
+	{
+		insert(ilist.begin(), ilist.end());
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::index_of_lower_bound(Key const & key) const -> size_t
+	{
+		Key const * const first = std::ranges::data(keys_);
+		return static_cast<size_t>(detail::flat_lower_bound<Key>(first, first + size(), key, compare_) - first);
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::lower_bound(Key const & key) -> iterator
+	{
+		return begin() + index_of_lower_bound(key);
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::lower_bound(Key const & key) const -> const_iterator
+	{
+		return begin() + index_of_lower_bound(key);
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::find(Key const & key) -> iterator
+	{
+		size_t const index = index_of_lower_bound(key);
+		return (index != size() && !compare_(key, keys_[index])) ? begin() + index : end();
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::find(Key const & key) const -> const_iterator
+	{
+		size_t const index = index_of_lower_bound(key);
+		return (index != size() && !compare_(key, keys_[index])) ? begin() + index : end();
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::contains(Key const & key) const -> bool
+	{
+		return find(key) != end();
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::count(Key const & key) const -> size_t
+	{
+		return contains(key) ? 1 : 0;
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::operator [] (Key const & key) -> Value & requires(std::is_default_constructible_v<Value>)
+	{
+		size_t const index = index_of_lower_bound(key);
+		if (index != size() && !compare_(key, keys_[index]))
+			return values_[index];
+		return *insert_at(index, Key(key), Value()).value;
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::insert(Key key, Value value) -> std::pair<iterator, bool>
+	{
+		size_t const index = index_of_lower_bound(key);
+		if (index != size() && !compare_(key, keys_[index]))
+			return {begin() + index, false};
+		return {insert_at(index, std::move(key), std::move(value)), true};
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::insert_or_assign(Key key, Value value) -> std::pair<iterator, bool>
+	{
+		size_t const index = index_of_lower_bound(key);
+		if (index != size() && !compare_(key, keys_[index]))
+		{
+			values_[index] = std::move(value);
+			return {begin() + index, false};
+		}
+		return {insert_at(index, std::move(key), std::move(value)), true};
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::insert(It first, Sentinel last) -> void
+	{
+		size_t const sorted_count = size();
+		for (It it = first; it != last; ++it)
+		{
+			auto && [key, value] = *it;
+			// Keys already in the map keep their values, so they don't need room.
+			if (is_in_first(sorted_count, key))
+				continue;
+			keys_.emplace_back(key);
+			values_.emplace_back(value);
+		}
+		sort_and_remove_duplicates(sorted_count);
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	template <std::ranges::input_range R>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::insert_range(R && range) -> void
+	{
+		insert(std::ranges::begin(range), std::ranges::end(range));
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::erase(const_iterator pos) -> iterator
+	{
+		auto const index = pos - begin();
+		keys_.erase(keys_.begin() + index);
+		values_.erase(values_.begin() + index);
+		return begin() + index;
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::erase(Key const & key) -> size_t
+	{
+		const_iterator const it = find(key);
+		if (it == end())
+			return 0;
+		erase(it);
+		return 1;
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::insert_at(size_t index, Key && key, Value && value) -> iterator
+	{
+		keys_.emplace_back(std::move(key));
+		std::rotate(keys_.begin() + index, keys_.end() - 1, keys_.end());
+		values_.emplace_back(std::move(value));
+		std::rotate(values_.begin() + index, values_.end() - 1, values_.end());
+		return begin() + index;
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::is_in_first(size_t count, Key const & key) const -> bool
+	{
+		Key const * const first = std::ranges::data(keys_);
+		Key const * const it = detail::flat_lower_bound<Key>(first, first + count, key, compare_);
+		return it != first + count && !compare_(key, *it);
+	}
+
+	template <typename Key, typename Value, typename Compare, typename KeyContainer, typename ValueContainer>
+		requires std::ranges::contiguous_range<KeyContainer> && std::ranges::contiguous_range<ValueContainer>
+	auto flat_map<Key, Value, Compare, KeyContainer, ValueContainer>::sort_and_remove_duplicates(size_t sorted_count) -> void
+	{
+		Key * const keys = std::ranges::data(keys_);
+		Value * const values = std::ranges::data(values_);
+		size_t const count = size();
+		detail::stable_sort_by_key(keys, values, sorted_count, count, compare_);
+		detail::merge_by_key(keys, values, 0, sorted_count, count, compare_);
+
+		// Stable, so the first of equal keys is the one that was there first.
+		size_t kept = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (kept > 0 && !compare_(keys[kept - 1], keys[i]))
+				continue;
+			if (kept != i)
+			{
+				keys[kept] = std::move(keys[i]);
+				values[kept] = std::move(values[i]);
+			}
+			++kept;
+		}
+		keys_.erase(keys_.begin() + static_cast<ptrdiff_t>(kept), keys_.end());
+		values_.erase(values_.begin() + static_cast<ptrdiff_t>(kept), values_.end());
+	}
+
+} // namespace aeh
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "algorithm.hh"
+#include <concepts>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		// Arithmetic keys are cheap to compare, so searching them is limited by branch mispredictions rather than by
+		// comparisons, and branchless_lower_bound is faster.
+		template <typename Key, typename Compare>
+		constexpr bool use_branchless_lower_bound = std::is_arithmetic_v<Key> && (
+			std::is_same_v<Compare, std::less<Key>> || std::is_same_v<Compare, std::less<>> ||
+			std::is_same_v<Compare, std::greater<Key>> || std::is_same_v<Compare, std::greater<>>);
+
+		template <typename Key, typename Compare, typename It, typename K>
+		constexpr auto flat_lower_bound(It first, It last, K const & key, Compare const & compare) -> It
+		{
+			if constexpr (use_branchless_lower_bound<Key, Compare>)
+				return branchless_lower_bound(first, last, key, compare);
+			else
+				return std::lower_bound(first, last, key, compare);
+		}
+	} // namespace detail
+
+	// Set stored as a sorted array of keys, for small, read-mostly sets where std::set's nodes scattered over the heap
+	// cost more than keeping the array sorted. Container is any contiguous container with emplace_back and erase,
+	// such as std::vector or fixed_capacity_vector. Inserting many keys at once is much faster with the constructor
+	// or the range version of insert, which sort once, than one at a time. Iterators are invalidated by any insertion
+	// or erasure.
+	template <typename Key, typename Compare = std::less<Key>, typename Container = std::vector<Key>>
+		requires std::ranges::contiguous_range<Container>
+	struct flat_set
+	{
+		using key_type = Key;
+		using value_type = Key;
+		using key_compare = Compare;
+		using container_type = Container;
+		using size_type = size_t;
+		using iterator = typename Container::const_iterator;
+		using const_iterator = typename Container::const_iterator;
+
+		flat_set() noexcept(std::is_nothrow_default_constructible_v<Container>) = default;
+		// Sorts the keys and removes duplicates, keeping the first of each.
+		explicit flat_set(Container keys, Compare compare = Compare());
+		flat_set(std::initializer_list<Key> ilist, Compare compare = Compare());
+
+		[[nodiscard]] auto size() const noexcept -> size_t { return keys_.size(); }
+		[[nodiscard]] auto empty() const noexcept -> bool { return keys_.empty(); }
+		[[nodiscard]] auto begin() const noexcept -> const_iterator { return keys_.begin(); }
+		[[nodiscard]] auto end() const noexcept -> const_iterator { return keys_.end(); }
+		[[nodiscard]] auto keys() const noexcept -> std::span<Key const> { return keys_; }
+		[[nodiscard]] auto key_comp() const noexcept -> Compare { return compare_; }
+		auto clear() noexcept -> void { keys_.clear(); }
+
+		[[nodiscard]] auto lower_bound(Key const & key) const -> const_iterator;
+		[[nodiscard]] auto upper_bound(Key const & key) const -> const_iterator;
+		[[nodiscard]] auto find(Key const & key) const -> const_iterator;
+		[[nodiscard]] auto contains(Key const & key) const -> bool;
+		[[nodiscard]] auto count(Key const & key) const -> size_t;
+
+		// Linear in size, since keys after the new one are moved.
+		auto insert(Key key) -> std::pair<iterator, bool>;
+		// Appends the keys and sorts them into place all at once. Keys already in the set are skipped. Keys that appear
+		// more than once in the range all take room until the sort removes the duplicates, which a container of fixed
+		// capacity must have.
+		template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+		auto insert(It first, Sentinel last) -> void;
+		template <std::ranges::input_range R>
+		auto insert_range(R && range) -> void;
+
+		auto erase(const_iterator pos) -> iterator;
+		auto erase(Key const & key) -> size_t;
+
+		// Gives up the sorted keys, leaving the set empty.
+		[[nodiscard]] auto extract() && -> Container;
+
+	private:
+		// Whether key is one of the first count keys, which are sorted.
+		[[nodiscard]] auto is_in_first(size_t count, Key const & key) const -> bool;
+		// Sorts keys from sorted_count onwards and merges them with the first sorted_count, which are already sorted.
+		auto sort_and_remove_duplicates(size_t sorted_count) -> void;
+
+		Container keys_;
+		[[no_unique_address]] Compare compare_;
+	};
+
+	template <typename Key, typename Compare, typename Container>
+	[[nodiscard]] auto operator == (flat_set<Key, Compare, Container> const & a, flat_set<Key, Compare, Container> const & b) -> bool;
+
+} // namespace aeh
+
+#include "flat_set.inl"
@@ -0,0 +1,133 @@
+namespace aeh
+{
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	flat_set<Key, Compare, Container>::flat_set(Container keys, Compare compare)
+		: keys_(std::move(keys))
+		, compare_(std::move(compare))
+	{
+		sort_and_remove_duplicates(0);
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	flat_set<Key, Compare, Container>::flat_set(std::initializer_list<Key> ilist, Compare compare)
+		: compare_(std::move(compare))
+	{
+		insert(ilist.begin(), ilist.end());
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::lower_bound(Key const & key) const -> const_iterator
+	{
+		return detail::flat_lower_bound<Key>(keys_.begin(), keys_.end(), key, compare_);
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::upper_bound(Key const & key) const -> const_iterator
+	{
+		return std::upper_bound(keys_.begin(), keys_.end(), key, compare_);
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::find(Key const & key) const -> const_iterator
+	{
+		const_iterator const it = lower_bound(key);
+		return (it != end() && !compare_(key, *it)) ? it : end();
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::contains(Key const & key) const -> bool
+	{
+		return find(key) != end();
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::count(Key const & key) const -> size_t
+	{
+		return contains(key) ? 1 : 0;
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::insert(Key key) -> std::pair<iterator, bool>
+	{
+		const_iterator const it = lower_bound(key);
+		auto const index = it - keys_.begin();
+		if (it != end() && !compare_(key, *it))
+			return {it, false};
+
+		keys_.emplace_back(std::move(key));
+		std::rotate(keys_.begin() + index, keys_.end() - 1, keys_.end());
+		return {keys_.begin() + index, true};
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+	auto flat_set<Key, Compare, Container>::insert(It first, Sentinel last) -> void
+	{
+		size_t const sorted_count = keys_.size();
+		for (It it = first; it != last; ++it)
+		{
+			auto && key = *it;
+			if (!is_in_first(sorted_count, key))
+				keys_.emplace_back(std::forward<decltype(key)>(key));
+		}
+		sort_and_remove_duplicates(sorted_count);
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	template <std::ranges::input_range R>
+	auto flat_set<Key, Compare, Container>::insert_range(R && range) -> void
+	{
+		insert(std::ranges::begin(range), std::ranges::end(range));
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::erase(const_iterator pos) -> iterator
+	{
+		return keys_.erase(pos);
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::erase(Key const & key) -> size_t
+	{
+		const_iterator const it = find(key);
+		if (it == end())
+			return 0;
+		keys_.erase(it);
+		return 1;
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::extract() && -> Container
+	{
+		Container keys = std::move(keys_);
+		keys_.clear();
+		return keys;
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::is_in_first(size_t count, Key const & key) const -> bool
+	{
+		auto const first = keys_.begin();
+		auto const it = detail::flat_lower_bound<Key>(first, first + static_cast<ptrdiff_t>(count), key, compare_);
+		return it != first + static_cast<ptrdiff_t>(count) && !compare_(key, *it);
+	}
+
+	template <typename Key, typename Compare, typename Container> requires std::ranges::contiguous_range<Container>
+	auto flat_set<Key, Compare, Container>::sort_and_remove_duplicates(size_t sorted_count) -> void
+	{
+		auto const middle = keys_.begin() + sorted_count;
+		// Stable, so that the first of equal keys is the one that was there first.
+		std::stable_sort(middle, keys_.end(), compare_);
+		std::inplace_merge(keys_.begin(), middle, keys_.end(), compare_);
+		auto const equivalent = [this](Key const & a, Key const & b) { return !compare_(a, b); };
+		keys_.erase(std::unique(keys_.begin(), keys_.end(), equivalent), keys_.end());
+	}
+
+	template <typename Key, typename Compare, typename Container>
+	auto operator == (flat_set<Key, Compare, Container> const & a, flat_set<Key, Compare, Container> const & b) -> bool
+	{
+		return std::ranges::equal(a.keys(), b.keys());
+	}
+
+} // namespace aeh
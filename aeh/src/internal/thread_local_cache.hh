@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aeh
+{
+	namespace detail
+	{
+		// Table, meant to be thread_local, of what a thread got from the last few objects it used of a type that hands out
+		// per-thread state, such as the magazine of a SlabAllocator. Keys are ids that are never reused, so entries of
+		// destroyed owners are never found again and just wait to be evicted. Entries are kept in most recently used order
+		// and the least recently used one is dropped when a new one doesn't fit, so a thread that uses more than N owners in
+		// turn takes the slow path again for the evicted one.
+		template <typename T, size_t N>
+		struct ThreadLocalCache
+		{
+			struct Entry
+			{
+				uint64_t owner_id = 0;
+				T * value = nullptr;
+			};
+
+			// Returns nullptr if there is no entry for owner_id. The value of the entry may be nullptr.
+			[[nodiscard]] auto find(uint64_t owner_id) noexcept -> Entry const *
+			{
+				// Most threads use the same owner over and over, which is always first.
+				if (entries[0].owner_id == owner_id)
+					return &entries[0];
+
+				for (size_t i = 1; i < N; ++i)
+				{
+					if (entries[i].owner_id == owner_id)
+					{
+						Entry const found = entries[i];
+						for (size_t j = i; j > 0; --j)
+							entries[j] = entries[j - 1];
+						entries[0] = found;
+						return &entries[0];
+					}
+				}
+				return nullptr;
+			}
+
+			auto insert(uint64_t owner_id, T * value) noexcept -> void
+			{
+				for (size_t j = N - 1; j > 0; --j)
+					entries[j] = entries[j - 1];
+				entries[0] = {owner_id, value};
+			}
+
+			auto erase(uint64_t owner_id) noexcept -> void
+			{
+				for (size_t i = 0; i < N; ++i)
+				{
+					if (entries[i].owner_id == owner_id)
+					{
+						for (size_t j = i; j + 1 < N; ++j)
+							entries[j] = entries[j + 1];
+						entries[N - 1] = Entry();
+						return;
+					}
+				}
+			}
+
+			Entry entries[N];
+		};
+	} // namespace detail
+} // namespace aeh
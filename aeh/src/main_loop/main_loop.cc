@@ -115,7 +115,7 @@ namespace aeh::main_loop::detail
 		return done;
 	}
 
-	RenderInput pre_render(SDL_Window * window, Options const & options)
+	RenderInput pre_render(SDL_Window * window, Options const & options, MemoryArena & frame_arena)
 	{
 		int window_width, window_height;
 		SDL_GetWindowSize(window, &window_width, &window_height);
@@ -124,7 +124,7 @@ namespace aeh::main_loop::detail
 		if (options.clear_every_frame)
 			gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
 
-		return RenderInput(window, viewport);
+		return RenderInput(window, viewport, frame_arena);
 	}
 
 	void post_render(SDL_Window * window)
@@ -5,6 +5,7 @@
 #include "optional_customization_points.hh"
 #include "function_ref.hh"
 #include "viewport.hh"
+#include "memory_arena.hh"
 #include <type_traits> // std::is_same_v
 #include <tuple>
 #include <optional>
@@ -28,6 +29,8 @@ namespace aeh::main_loop
 	struct Options
 	{
 		bool clear_every_frame = true;
+		// Address space reserved for each of the two frame arenas. Only what frames actually use is committed.
+		size_t frame_arena_size = 256 * 1024 * 1024;
 	};
 
 	struct NewWindowOptions : Options
@@ -73,15 +76,19 @@ namespace aeh::main_loop
 	
 	struct UpdateInput
 	{
-		explicit UpdateInput(float dt_, SDL_Window * window_, bool & done_, int & exit_code_) noexcept 
+		explicit UpdateInput(float dt_, SDL_Window * window_, MemoryArena & frame_arena_, bool & done_, int & exit_code_) noexcept 
 			: dt(dt_)
 			, window(window_)
+			, frame_arena(frame_arena_)
 			, done(done_)
 			, exit_code(exit_code_)
 		{}
 
 		float const dt;
 		SDL_Window * const window;
+		// Scratch memory for the current frame. It is freed at the start of the frame after the next one, so what a
+		// frame allocates can still be read during the next frame.
+		MemoryArena & frame_arena;
 
 		void quit(int exit_code_ = 0) const noexcept { done = true; exit_code = exit_code_; }
 
@@ -92,13 +99,16 @@ namespace aeh::main_loop
 
 	struct RenderInput
 	{
-		explicit RenderInput(SDL_Window * const window_, Viewport const viewport_) noexcept
+		explicit RenderInput(SDL_Window * const window_, Viewport const viewport_, MemoryArena & frame_arena_) noexcept
 			: window(window_)
 			, viewport(viewport_)
+			, frame_arena(frame_arena_)
 		{}
 
 		SDL_Window * const window;
 		Viewport const viewport;
+		// Same arena as UpdateInput::frame_arena.
+		MemoryArena & frame_arena;
 	};
 
 	template <typename Demo>
@@ -4,7 +4,7 @@ namespace aeh::main_loop
 	namespace detail
 	{
 		bool update(SDL_Window * window, function_ref<void(SDL_Event const &)> demo_process_event);
-		RenderInput pre_render(SDL_Window * window, Options const & options);
+		RenderInput pre_render(SDL_Window * window, Options const & options, MemoryArena & frame_arena);
 		void post_render(SDL_Window * window);
 		float cap_fps(std::chrono::steady_clock::time_point time_start) noexcept;
 	} // namespace detail
@@ -18,9 +18,13 @@ namespace aeh::main_loop
 		bool done = false;
 		int exit_code = 0;
 		float dt = 1.0f / 60.0f;
+		auto frame_arenas = DoubleBufferedMemoryArena::with_virtual_region(options.frame_arena_size);
+		frame_arenas.current().set_telemetry_name("main_loop frame arena");
+		frame_arenas.previous().set_telemetry_name("main_loop frame arena");
 		while (!done)
 		{
 			auto const time_start = std::chrono::steady_clock::now();
+			frame_arenas.flip();
 
 			auto locals = main_loop::detail::call_start_frame(demo);
 
@@ -28,13 +32,13 @@ namespace aeh::main_loop
 			done = main_loop::detail::update(window,
 				[&demo, &locals](SDL_Event const & ev) { main_loop::detail::call_process_event(demo, ev, locals); });
 
-			auto update_input = main_loop::UpdateInput(dt, window, done, exit_code);
+			auto update_input = main_loop::UpdateInput(dt, window, frame_arenas.current(), done, exit_code);
 			main_loop::detail::call_update(demo, update_input, locals);
 
 			// Rendering
 			if (!done)
 			{
-				RenderInput const render_input = main_loop::detail::pre_render(window, options);
+				RenderInput const render_input = main_loop::detail::pre_render(window, options, frame_arenas.current());
 				main_loop::detail::render_demo(demo, render_input, locals);
 				main_loop::detail::post_render(window);
 
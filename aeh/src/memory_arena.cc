@@ -1,32 +1,132 @@
 #include "memory_arena.hh"
 #include "align.hh"
+#include "json_string_builder.hh"
+#include "debug/unreachable.hh"
 #include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <utility>
 
 namespace aeh
 {
 
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+	namespace
+	{
+		// Arenas register themselves when they are constructed and leave when they are destroyed. Never destroyed, so
+		// that arenas with static storage duration can leave after the end of main.
+		struct MemoryArenaRegistry
+		{
+			std::mutex mutex;
+			std::vector<MemoryArena const *> arenas;
+		};
+
+		auto memory_arena_registry() -> MemoryArenaRegistry &
+		{
+			static MemoryArenaRegistry & registry = *new MemoryArenaRegistry;
+			return registry;
+		}
+
+		// Counters have a single writer, so they don't need read-modify-write operations.
+		auto add(std::atomic<size_t> & counter, size_t n) noexcept -> void
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		auto raise(std::atomic<size_t> & counter, size_t value) noexcept -> void
+		{
+			if (value > counter.load(std::memory_order_relaxed))
+				counter.store(value, std::memory_order_relaxed);
+		}
+
+		auto take(std::atomic<size_t> & counter, std::atomic<size_t> & from) noexcept -> void
+		{
+			counter.store(from.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+
+		auto snapshot_of(detail::MemoryArenaCounters const & counters) noexcept -> MemoryArenaTelemetry
+		{
+			MemoryArenaTelemetry telemetry;
+			telemetry.name = counters.name.load(std::memory_order_relaxed);
+			telemetry.allocated_bytes = counters.allocated_bytes.load(std::memory_order_relaxed);
+			telemetry.peak_allocated_bytes = counters.peak_allocated_bytes.load(std::memory_order_relaxed);
+			telemetry.committed_bytes = counters.committed_bytes.load(std::memory_order_relaxed);
+			telemetry.peak_committed_bytes = counters.peak_committed_bytes.load(std::memory_order_relaxed);
+			telemetry.reserved_bytes = counters.reserved_bytes.load(std::memory_order_relaxed);
+			telemetry.grow_count = counters.grow_count.load(std::memory_order_relaxed);
+			telemetry.shrink_count = counters.shrink_count.load(std::memory_order_relaxed);
+			telemetry.alignment_padding_bytes = counters.alignment_padding_bytes.load(std::memory_order_relaxed);
+			return telemetry;
+		}
+	} // namespace
+#endif
+
+	MemoryArena::MemoryArena() noexcept
+	{
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		MemoryArenaRegistry & registry = memory_arena_registry();
+		auto const lock = std::lock_guard(registry.mutex);
+		registry.arenas.push_back(this);
+#endif
+	}
+
 	MemoryArena::MemoryArena(MemoryArena && other) noexcept
-		: virtual_memory_region(std::move(other.virtual_memory_region))
-		, allocated_byte_count(other.allocated_byte_count)
+		: MemoryArena()
 	{
-		other.allocated_byte_count = 0;
+		*this = std::move(other);
+	}
+
+	MemoryArena::~MemoryArena()
+	{
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		MemoryArenaRegistry & registry = memory_arena_registry();
+		auto const lock = std::lock_guard(registry.mutex);
+		auto const it = std::find(registry.arenas.begin(), registry.arenas.end(), this);
+		*it = registry.arenas.back();
+		registry.arenas.pop_back();
+#endif
 	}
 
 	auto MemoryArena::operator = (MemoryArena && other) noexcept -> MemoryArena &
 	{
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		counters.name.store(other.counters.name.exchange(nullptr, std::memory_order_relaxed), std::memory_order_relaxed);
+		take(counters.allocated_bytes, other.counters.allocated_bytes);
+		take(counters.peak_allocated_bytes, other.counters.peak_allocated_bytes);
+		take(counters.committed_bytes, other.counters.committed_bytes);
+		take(counters.peak_committed_bytes, other.counters.peak_committed_bytes);
+		take(counters.reserved_bytes, other.counters.reserved_bytes);
+		take(counters.grow_count, other.counters.grow_count);
+		take(counters.shrink_count, other.counters.shrink_count);
+		take(counters.alignment_padding_bytes, other.counters.alignment_padding_bytes);
+#endif
 		virtual_memory_region = std::move(other.virtual_memory_region);
-		allocated_byte_count = other.allocated_byte_count;
-		other.allocated_byte_count = 0;
+		allocated_byte_count = std::exchange(other.allocated_byte_count, 0);
+		bytes_kept_committed = std::exchange(other.bytes_kept_committed, 0);
+		prefault_on_commit = other.prefault_on_commit;
+		decommit_options = other.decommit_options;
+		peak_since_free = std::exchange(other.peak_since_free, 0);
+		retained_peak = std::exchange(other.retained_peak, 0);
+		frees_since_retained_peak = std::exchange(other.frees_since_retained_peak, 0);
+		retained_peak_time = other.retained_peak_time;
+		touched_byte_count = std::exchange(other.touched_byte_count, 0);
 		return *this;
 	}
 
-	auto MemoryArena::with_virtual_region(size_t virtual_memory_region_size_in_bytes) noexcept -> MemoryArena
+	auto MemoryArena::with_virtual_region(size_t virtual_memory_region_size_in_bytes, PageSize page_size, Prefault prefault) noexcept -> MemoryArena
+	{
+		return in_virtual_region(VirtualMemoryRegion::reserve_bytes_of_virtual_memory(virtual_memory_region_size_in_bytes, page_size), prefault);
+	}
+
+	auto MemoryArena::in_virtual_region(VirtualMemoryRegion region, Prefault prefault) noexcept -> MemoryArena
 	{
 		MemoryArena new_arena;
-		new_arena.virtual_memory_region = VirtualMemoryRegion::reserve_bytes_of_virtual_memory(virtual_memory_region_size_in_bytes);
+		new_arena.virtual_memory_region = std::move(region);
+		new_arena.prefault_on_commit = prefault;
 
 		// Allocate a page of memory from the beginning.
-		new_arena.virtual_memory_region.allocate_extra_pages_of_physical_memory(1);
+		if (new_arena.virtual_memory_region.allocate_extra_pages_of_physical_memory(1, prefault))
+			new_arena.record_commit_change(true);
 
 		return new_arena;
 	}
@@ -39,25 +139,277 @@ namespace aeh
 		// Grow exponentially, except if the requested allocation requires growing even more.
 		if (allocated_end > virtual_memory_region.physical_memory_size_in_bytes())
 		{
-			size_t const memory_pages_needed_to_hold_current_allocation = align_to_os_memory_page_boundary(allocated_end) / os_memory_page_size;
+			size_t const memory_pages_needed_to_hold_current_allocation = virtual_memory_region.align_to_page_boundary(allocated_end) / virtual_memory_region.page_size();
 			size_t const twice_the_current_pages = virtual_memory_region.physical_memory_size_in_pages() * 2;
 			size_t const new_pages_to_allocate = std::max(memory_pages_needed_to_hold_current_allocation, twice_the_current_pages) - virtual_memory_region.physical_memory_size_in_pages();
-			virtual_memory_region.allocate_extra_pages_of_physical_memory(new_pages_to_allocate);
+			if (virtual_memory_region.allocate_extra_pages_of_physical_memory(new_pages_to_allocate, prefault_on_commit))
+				record_commit_change(true);
 		}
 
+		record_allocation(aligned_start - allocated_byte_count, allocated_end);
 		allocated_byte_count = allocated_end;
+		peak_since_free = std::max(peak_since_free, allocated_end);
 		return static_cast<char *>(virtual_memory_region.memory_region_address()) + aligned_start;
 	}
 
 	auto MemoryArena::free_up_to(size_t number_of_bytes_to_keep) noexcept -> void
 	{
 		allocated_byte_count = number_of_bytes_to_keep;
+		size_t const peak = std::exchange(peak_since_free, number_of_bytes_to_keep);
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		counters.allocated_bytes.store(number_of_bytes_to_keep, std::memory_order_relaxed);
+#endif
+
+		// Pages committed with commit() are never given back.
+		size_t const bytes_to_keep = virtual_memory_region.align_to_page_boundary(std::max(bytes_to_keep_committed_after_free(number_of_bytes_to_keep, peak), bytes_kept_committed));
+		if (bytes_to_keep >= committed_bytes())
+			return;
 
-		// Shring by halving the amount of space in use, when even after halving there's still a whole page left.
-		// This is aimed to avoid the pathological case of constantly allocating and deallocating when allocated size
-		// is very close to reallocation boundary.
-		if ((number_of_bytes_to_keep + os_memory_page_size) < virtual_memory_region.physical_memory_size_in_bytes() / 2)
+		if (decommit_options.release == PageRelease::decommit)
+		{
+			if (virtual_memory_region.free_all_pages_of_physical_memory_up_to(bytes_to_keep / virtual_memory_region.page_size()))
+				record_commit_change(false);
+		}
+		else
+		{
+			// Only pages that were touched since they were last released need to be released again.
+			size_t const touched_bytes = std::min(virtual_memory_region.align_to_page_boundary(std::max(touched_byte_count, peak)), committed_bytes());
+			if (bytes_to_keep < touched_bytes)
+			{
+				size_t const page_size = virtual_memory_region.page_size();
+				// Pages that failed to be discarded are still touched.
+				if (!virtual_memory_region.discard_pages_of_physical_memory(bytes_to_keep / page_size, (touched_bytes - bytes_to_keep) / page_size))
+					return;
+				record_commit_change(false);
+			}
+			touched_byte_count = bytes_to_keep;
+		}
+	}
+
+	auto MemoryArena::bytes_to_keep_committed_after_free(size_t number_of_bytes_to_keep, size_t peak) noexcept -> size_t
+	{
+		switch (decommit_options.policy)
+		{
+			case DecommitPolicy::halve_below_half:
+				// Shring by halving the amount of space in use, when even after halving there's still a whole page left.
+				// This is aimed to avoid the pathological case of constantly allocating and deallocating when allocated size
+				// is very close to reallocation boundary.
+				if ((number_of_bytes_to_keep + virtual_memory_region.page_size()) < committed_bytes() / 2)
+					return committed_bytes() / 2;
+				else
+					return committed_bytes();
+
+			case DecommitPolicy::never:
+				return committed_bytes();
+
+			case DecommitPolicy::high_water_mark:
+				if (peak >= retained_peak || ++frees_since_retained_peak >= decommit_options.window)
+				{
+					retained_peak = peak;
+					frees_since_retained_peak = 0;
+				}
+				return retained_peak;
+
+			case DecommitPolicy::delayed:
+			{
+				auto const now = std::chrono::steady_clock::now();
+				if (peak >= retained_peak || now - retained_peak_time >= decommit_options.delay)
+				{
+					retained_peak = peak;
+					retained_peak_time = now;
+				}
+				return retained_peak;
+			}
+		}
+
+		debug::declare_unreachable();
+	}
+
+	auto MemoryArena::commit(size_t number_of_bytes, Prefault prefault) noexcept -> void
+	{
+		size_t const bytes_to_commit = std::min(virtual_memory_region.align_to_page_boundary(number_of_bytes), reserved_bytes());
+		if (bytes_to_commit > committed_bytes())
+		{
+			if (virtual_memory_region.allocate_extra_pages_of_physical_memory((bytes_to_commit - committed_bytes()) / virtual_memory_region.page_size(), prefault))
+				record_commit_change(true);
+		}
+		bytes_kept_committed = std::max(bytes_kept_committed, bytes_to_commit);
+	}
+
+	auto MemoryArena::set_telemetry_name([[maybe_unused]] char const * name) noexcept -> void
+	{
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		counters.name.store(name, std::memory_order_relaxed);
+#endif
+	}
+
+	auto MemoryArena::telemetry() const noexcept -> MemoryArenaTelemetry
+	{
+		MemoryArenaTelemetry telemetry;
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		telemetry = snapshot_of(counters);
+#endif
+		telemetry.allocated_bytes = allocated_bytes();
+		telemetry.committed_bytes = committed_bytes();
+		telemetry.reserved_bytes = reserved_bytes();
+		return telemetry;
+	}
+
+	auto MemoryArena::record_allocation([[maybe_unused]] size_t padding, [[maybe_unused]] size_t allocated_end) noexcept -> void
+	{
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		counters.allocated_bytes.store(allocated_end, std::memory_order_relaxed);
+		raise(counters.peak_allocated_bytes, allocated_end);
+		if (padding > 0)
+			add(counters.alignment_padding_bytes, padding);
+#endif
+	}
+
+	auto MemoryArena::record_commit_change([[maybe_unused]] bool grew) noexcept -> void
+	{
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		add(grew ? counters.grow_count : counters.shrink_count, 1);
+		counters.committed_bytes.store(committed_bytes(), std::memory_order_relaxed);
+		raise(counters.peak_committed_bytes, committed_bytes());
+		counters.reserved_bytes.store(reserved_bytes(), std::memory_order_relaxed);
+#endif
+	}
+
+	auto telemetry_of_all_memory_arenas() -> std::vector<MemoryArenaTelemetry>
+	{
+		std::vector<MemoryArenaTelemetry> telemetry;
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		MemoryArenaRegistry & registry = memory_arena_registry();
+		auto const lock = std::lock_guard(registry.mutex);
+		telemetry.reserve(registry.arenas.size());
+		for (MemoryArena const * arena : registry.arenas)
+			telemetry.push_back(snapshot_of(arena->counters));
+#endif
+		return telemetry;
+	}
+
+	void operator << (json::ValueBuilder & builder, MemoryArenaTelemetry const & telemetry)
+	{
+		auto object = builder.object();
+		if (telemetry.name != nullptr)
+			object["name"] << std::string_view(telemetry.name);
+		else
+			object["name"] << nullptr;
+		object["allocated_bytes"] << static_cast<uint64_t>(telemetry.allocated_bytes);
+		object["peak_allocated_bytes"] << static_cast<uint64_t>(telemetry.peak_allocated_bytes);
+		object["committed_bytes"] << static_cast<uint64_t>(telemetry.committed_bytes);
+		object["peak_committed_bytes"] << static_cast<uint64_t>(telemetry.peak_committed_bytes);
+		object["reserved_bytes"] << static_cast<uint64_t>(telemetry.reserved_bytes);
+		object["grow_count"] << static_cast<uint64_t>(telemetry.grow_count);
+		object["shrink_count"] << static_cast<uint64_t>(telemetry.shrink_count);
+		object["alignment_padding_bytes"] << static_cast<uint64_t>(telemetry.alignment_padding_bytes);
+	}
+
+	auto write_memory_arena_telemetry(json::ValueBuilder & builder) -> void
+	{
+		auto array = builder.array();
+		for (MemoryArenaTelemetry const & telemetry : telemetry_of_all_memory_arenas())
+			array << telemetry;
+	}
+
+	auto DoubleBufferedMemoryArena::with_virtual_region(size_t virtual_memory_region_size_in_bytes_per_arena, PageSize page_size) noexcept -> DoubleBufferedMemoryArena
+	{
+		DoubleBufferedMemoryArena double_buffered;
+		for (MemoryArena & arena : double_buffered.arenas)
+		{
+			arena = MemoryArena::with_virtual_region(virtual_memory_region_size_in_bytes_per_arena, page_size);
+			arena.set_decommit_options({.policy = DecommitPolicy::high_water_mark});
+		}
+		return double_buffered;
+	}
+
+	auto DoubleBufferedMemoryArena::flip() noexcept -> void
+	{
+		current_index ^= 1;
+		arenas[current_index].free_all();
+	}
+
+	ConcurrentMemoryArena::ConcurrentMemoryArena(size_t virtual_memory_region_size_in_bytes, PageSize page_size, Prefault prefault) noexcept
+		: virtual_memory_region(VirtualMemoryRegion::reserve_bytes_of_virtual_memory(virtual_memory_region_size_in_bytes, page_size))
+		, prefault_on_commit(prefault)
+	{
+		// Allocate a page of memory from the beginning.
+		virtual_memory_region.allocate_extra_pages_of_physical_memory(1, prefault);
+		committed_byte_count.store(virtual_memory_region.physical_memory_size_in_bytes(), std::memory_order_relaxed);
+	}
+
+	auto ConcurrentMemoryArena::with_virtual_region(size_t virtual_memory_region_size_in_bytes, PageSize page_size, Prefault prefault) noexcept -> ConcurrentMemoryArena
+	{
+		return ConcurrentMemoryArena(virtual_memory_region_size_in_bytes, page_size, prefault);
+	}
+
+	auto ConcurrentMemoryArena::allocate(size_t bytes, size_t alignment) noexcept -> void *
+	{
+		// Allocations that don't fit fail before claiming any space, so that smaller ones can still fit after them.
+		size_t const reserved_bytes = virtual_memory_region.virtual_memory_size_in_bytes();
+		size_t start = allocated_byte_count.load(std::memory_order_relaxed);
+		size_t aligned_start;
+		size_t allocated_end;
+		do
+		{
+			aligned_start = align(start, alignment);
+			allocated_end = aligned_start + bytes;
+			if (allocated_end > reserved_bytes)
+				return nullptr;
+		} while (!allocated_byte_count.compare_exchange_weak(start, allocated_end, std::memory_order_relaxed));
+
+		if (allocated_end > committed_byte_count.load(std::memory_order_acquire) && !commit_up_to(allocated_end))
+			return nullptr;
+
+		return static_cast<char *>(virtual_memory_region.memory_region_address()) + aligned_start;
+	}
+
+	auto ConcurrentMemoryArena::commit_up_to(size_t end) noexcept -> bool
+	{
+		auto const lock = std::lock_guard(commit_mutex);
+
+		// Another thread may have committed enough while this one waited for the lock.
+		if (end <= virtual_memory_region.physical_memory_size_in_bytes())
+			return true;
+
+		// Same growth policy as MemoryArena, without going past the end of the reserved region.
+		size_t const memory_pages_needed_to_hold_current_allocation = virtual_memory_region.align_to_page_boundary(end) / virtual_memory_region.page_size();
+		size_t const twice_the_current_pages = virtual_memory_region.physical_memory_size_in_pages() * 2;
+		size_t const max_pages = virtual_memory_region.virtual_memory_size_in_pages();
+		size_t const new_page_count = std::max(memory_pages_needed_to_hold_current_allocation, std::min(twice_the_current_pages, max_pages));
+		if (!virtual_memory_region.allocate_extra_pages_of_physical_memory(new_page_count - virtual_memory_region.physical_memory_size_in_pages(), prefault_on_commit))
+			return false;
+		committed_byte_count.store(virtual_memory_region.physical_memory_size_in_bytes(), std::memory_order_release);
+		return true;
+	}
+
+	auto ConcurrentMemoryArena::free_up_to(size_t number_of_bytes_to_keep) noexcept -> void
+	{
+		auto const lock = std::lock_guard(commit_mutex);
+		allocated_byte_count.store(number_of_bytes_to_keep, std::memory_order_relaxed);
+
+		// Same shrinking policy as MemoryArena.
+		if ((number_of_bytes_to_keep + virtual_memory_region.page_size()) < virtual_memory_region.physical_memory_size_in_bytes() / 2)
+		{
 			virtual_memory_region.free_all_pages_of_physical_memory_up_to(virtual_memory_region.physical_memory_size_in_pages() / 2);
+			committed_byte_count.store(virtual_memory_region.physical_memory_size_in_bytes(), std::memory_order_relaxed);
+		}
+	}
+
+	auto MemoryArenaResource::do_allocate(size_t bytes, size_t alignment) -> void *
+	{
+		return memory_arena->allocate(bytes, alignment);
+	}
+
+	auto MemoryArenaResource::do_deallocate(void *, size_t, size_t) -> void
+	{
+		// Memory is freed all at once through the arena.
+	}
+
+	auto MemoryArenaResource::do_is_equal(std::pmr::memory_resource const & other) const noexcept -> bool
+	{
+		auto const * const other_arena_resource = dynamic_cast<MemoryArenaResource const *>(&other);
+		return other_arena_resource != nullptr && other_arena_resource->memory_arena == memory_arena;
 	}
 
 } // namespace aeh
@@ -1,30 +1,164 @@
 #pragma once
 
 #include "virtual_memory.hh"
+#include "align.hh"
+#include "compatibility.hh"
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace aeh::json
+{
+	struct ValueBuilder;
+} // namespace aeh::json
 
 namespace aeh
 {
 
+	// How much physical memory a MemoryArena keeps committed when memory is freed.
+	enum struct DecommitPolicy
+	{
+		// Halves committed memory when less than half of it is in use.
+		halve_below_half,
+		// Keeps everything that was ever committed.
+		never,
+		// Keeps the highest usage committed until it hasn't been reached in the last window calls to free_up_to.
+		high_water_mark,
+		// Keeps the highest usage committed until it hasn't been reached for delay.
+		delayed,
+	};
+
+	// How a MemoryArena gives back the pages its decommit policy doesn't keep.
+	enum struct PageRelease
+	{
+		// Decommits the pages. Using them again takes a system call to commit them and a page fault for each page.
+		decommit,
+		// Leaves the pages committed but lets the system reclaim their physical memory when it needs it, with MADV_FREE
+		// (or MADV_DONTNEED where it isn't supported) on Linux and MEM_RESET on Windows. Pages that weren't reclaimed
+		// are reused without a system call or page fault.
+		lazy,
+	};
+
+	struct MemoryArenaDecommitOptions
+	{
+		DecommitPolicy policy = DecommitPolicy::halve_below_half;
+		PageRelease release = PageRelease::decommit;
+		size_t window = 16;
+		std::chrono::steady_clock::duration delay = std::chrono::seconds(1);
+	};
+
+	// Usage of a memory arena, to size its reservation from what it actually needs. Only the current sizes are filled in
+	// unless aeh is built with AEH_WITH_MEMORY_ARENA_TELEMETRY. Otherwise tracking compiles away and the rest is 0.
+	struct MemoryArenaTelemetry
+	{
+		char const * name = nullptr;
+		size_t allocated_bytes = 0;
+		size_t peak_allocated_bytes = 0;
+		size_t committed_bytes = 0;
+		size_t peak_committed_bytes = 0;
+		size_t reserved_bytes = 0;
+		// Calls into the virtual memory region that committed pages, and that decommitted or discarded them.
+		size_t grow_count = 0;
+		size_t shrink_count = 0;
+		// Bytes skipped to align allocations.
+		size_t alignment_padding_bytes = 0;
+
+		friend void operator << (json::ValueBuilder & builder, MemoryArenaTelemetry const & telemetry);
+	};
+
+	namespace detail
+	{
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+		constexpr bool collect_memory_arena_telemetry = true;
+#else
+		constexpr bool collect_memory_arena_telemetry = false;
+#endif
+
+		// Only the thread that uses the arena writes them, but the registry may read them from any thread.
+		struct MemoryArenaCounters
+		{
+			std::atomic<char const *> name = nullptr;
+			std::atomic<size_t> allocated_bytes = 0;
+			std::atomic<size_t> peak_allocated_bytes = 0;
+			std::atomic<size_t> committed_bytes = 0;
+			std::atomic<size_t> peak_committed_bytes = 0;
+			std::atomic<size_t> reserved_bytes = 0;
+			std::atomic<size_t> grow_count = 0;
+			std::atomic<size_t> shrink_count = 0;
+			std::atomic<size_t> alignment_padding_bytes = 0;
+		};
+
+		struct NoMemoryArenaCounters {};
+	} // namespace detail
+
 	struct MemoryArena
 	{
-		MemoryArena() noexcept = default;
+		MemoryArena() noexcept;
 		MemoryArena(MemoryArena const &) = delete;
 		MemoryArena(MemoryArena &&) noexcept;
 		auto operator = (MemoryArena const &) = delete;
 		auto operator = (MemoryArena &&) noexcept -> MemoryArena &;
+		~MemoryArena();
 
-		[[nodiscard]] static auto with_virtual_region(size_t virtual_region_size_in_bytes) noexcept -> MemoryArena;
+		// With Prefault::yes, pages are faulted in as the arena grows, so that allocations don't fault on first touch.
+		[[nodiscard]] static auto with_virtual_region(size_t virtual_region_size_in_bytes, PageSize page_size = PageSize::os_default, Prefault prefault = Prefault::no) noexcept -> MemoryArena;
+		// Allocates from an already reserved region, such as a subregion of a bigger reservation.
+		[[nodiscard]] static auto in_virtual_region(VirtualMemoryRegion region, Prefault prefault = Prefault::no) noexcept -> MemoryArena;
 
 		[[nodiscard]] auto allocate(size_t bytes, size_t alignment) noexcept -> void *;
 		[[nodiscard]] auto allocated_bytes() const noexcept -> size_t { return allocated_byte_count; }
 		auto free_up_to(size_t number_of_bytes_to_keep) noexcept -> void;
 		auto free_all() noexcept -> void { free_up_to(0); }
 
+		// Commits physical memory for at least the first number_of_bytes of the arena up front, and keeps it committed
+		// when memory is freed. Pass reserved_bytes() to commit the whole arena.
+		auto commit(size_t number_of_bytes, Prefault prefault = Prefault::yes) noexcept -> void;
+
+		auto set_decommit_options(MemoryArenaDecommitOptions const & options) noexcept -> void { decommit_options = options; }
+		[[nodiscard]] auto committed_bytes() const noexcept -> size_t { return virtual_memory_region.physical_memory_size_in_bytes(); }
+		[[nodiscard]] auto reserved_bytes() const noexcept -> size_t { return virtual_memory_region.virtual_memory_size_in_bytes(); }
+
+		// The name is shown in telemetry. It must outlive the arena, like a string literal.
+		auto set_telemetry_name(char const * name) noexcept -> void;
+		[[nodiscard]] auto telemetry() const noexcept -> MemoryArenaTelemetry;
+
 	private:
+		[[nodiscard]] auto bytes_to_keep_committed_after_free(size_t number_of_bytes_to_keep, size_t peak) noexcept -> size_t;
+		auto record_allocation(size_t padding, size_t allocated_end) noexcept -> void;
+		auto record_commit_change(bool grew) noexcept -> void;
+
+		using Counters = std::conditional_t<detail::collect_memory_arena_telemetry, detail::MemoryArenaCounters, detail::NoMemoryArenaCounters>;
+		AEH_NO_UNIQUE_ADDRESS Counters counters;
+
 		VirtualMemoryRegion virtual_memory_region;
 		size_t allocated_byte_count = 0;
+		size_t bytes_kept_committed = 0;
+		Prefault prefault_on_commit = Prefault::no;
+
+		MemoryArenaDecommitOptions decommit_options;
+		// Highest allocated_byte_count since the last call to free_up_to.
+		size_t peak_since_free = 0;
+		// Highest usage that high_water_mark and delayed keep committed, and when it was last reached.
+		size_t retained_peak = 0;
+		size_t frees_since_retained_peak = 0;
+		std::chrono::steady_clock::time_point retained_peak_time;
+		// With PageRelease::lazy, end of the pages that may have been touched since they were last released.
+		size_t touched_byte_count = 0;
+
+		friend auto telemetry_of_all_memory_arenas() -> std::vector<MemoryArenaTelemetry>;
 	};
 
+	// Telemetry of every MemoryArena alive in the process, for example to dump them all to a log. Safe to call from any
+	// thread while the arenas are in use, although the numbers of an arena in use may be slightly out of sync with each
+	// other. Empty unless aeh is built with AEH_WITH_MEMORY_ARENA_TELEMETRY.
+	[[nodiscard]] auto telemetry_of_all_memory_arenas() -> std::vector<MemoryArenaTelemetry>;
+
+	// Writes telemetry_of_all_memory_arenas() as an array of objects.
+	auto write_memory_arena_telemetry(json::ValueBuilder & builder) -> void;
+
 	struct MemoryArenaScopeGuard
 	{
 		[[nodiscard]] explicit MemoryArenaScopeGuard(MemoryArena & arena) noexcept
@@ -44,4 +178,96 @@ namespace aeh
 		size_t original_allocated_bytes;
 	};
 
+	// Two memory arenas used in turns, for memory that lives for one iteration of a loop, such as a frame, and must still
+	// be readable during the next one. flip() frees the older arena and makes it current, so memory allocated from
+	// current() stays valid until the second call to flip() after the allocation. Arenas keep their highest usage
+	// committed by default, so a loop that allocates about the same every iteration doesn't make system calls.
+	struct DoubleBufferedMemoryArena
+	{
+		DoubleBufferedMemoryArena() noexcept = default;
+
+		[[nodiscard]] static auto with_virtual_region(size_t virtual_region_size_in_bytes_per_arena, PageSize page_size = PageSize::os_default) noexcept -> DoubleBufferedMemoryArena;
+
+		[[nodiscard]] auto current() noexcept -> MemoryArena & { return arenas[current_index]; }
+		[[nodiscard]] auto previous() noexcept -> MemoryArena & { return arenas[current_index ^ 1]; }
+		auto flip() noexcept -> void;
+
+	private:
+		MemoryArena arenas[2];
+		size_t current_index = 0;
+	};
+
+	// Memory arena that many threads can allocate from at the same time. Space is claimed with a compare-and-swap on the
+	// allocated byte count, and only allocations that reach past the committed pages take a lock to commit more.
+	// Freeing must not happen while other threads are allocating.
+	struct ConcurrentMemoryArena
+	{
+		ConcurrentMemoryArena(ConcurrentMemoryArena const &) = delete;
+		ConcurrentMemoryArena(ConcurrentMemoryArena &&) = delete;
+		auto operator = (ConcurrentMemoryArena const &) -> ConcurrentMemoryArena & = delete;
+		auto operator = (ConcurrentMemoryArena &&) -> ConcurrentMemoryArena & = delete;
+
+		// With Prefault::yes, pages are faulted in as the arena grows, like in MemoryArena.
+		[[nodiscard]] static auto with_virtual_region(size_t virtual_region_size_in_bytes, PageSize page_size = PageSize::os_default, Prefault prefault = Prefault::no) noexcept -> ConcurrentMemoryArena;
+
+		// Returns nullptr if the allocation doesn't fit in the reserved region or its pages can't be committed.
+		[[nodiscard]] auto allocate(size_t bytes, size_t alignment) noexcept -> void *;
+		[[nodiscard]] auto allocated_bytes() const noexcept -> size_t { return allocated_byte_count.load(std::memory_order_relaxed); }
+		auto free_up_to(size_t number_of_bytes_to_keep) noexcept -> void;
+		auto free_all() noexcept -> void { free_up_to(0); }
+
+	private:
+		explicit ConcurrentMemoryArena(size_t virtual_region_size_in_bytes, PageSize page_size, Prefault prefault) noexcept;
+
+		// Returns whether at least end bytes are committed after the call.
+		auto commit_up_to(size_t end) noexcept -> bool;
+
+		VirtualMemoryRegion virtual_memory_region;
+		alignas(cache_line_size) std::atomic<size_t> allocated_byte_count = 0;
+		// Mirrors virtual_memory_region.physical_memory_size_in_bytes() so that the fast path doesn't read the region
+		// while another thread commits pages.
+		alignas(cache_line_size) std::atomic<size_t> committed_byte_count = 0;
+		std::mutex commit_mutex;
+		Prefault prefault_on_commit;
+	};
+
+	// Lets std::pmr containers allocate from a memory arena. Deallocation does nothing: memory is given back to the arena
+	// all at once, for example by a MemoryArenaScopeGuard, so containers using it must not outlive that point.
+	struct MemoryArenaResource final : std::pmr::memory_resource
+	{
+		[[nodiscard]] explicit MemoryArenaResource(MemoryArena & arena) noexcept : memory_arena(&arena) {}
+
+		[[nodiscard]] auto arena() const noexcept -> MemoryArena & { return *memory_arena; }
+
+	private:
+		auto do_allocate(size_t bytes, size_t alignment) -> void * override;
+		auto do_deallocate(void * p, size_t bytes, size_t alignment) -> void override;
+		auto do_is_equal(std::pmr::memory_resource const & other) const noexcept -> bool override;
+
+		MemoryArena * memory_arena;
+	};
+
+	// Allocator that takes memory from a memory arena, for containers with an Allocator parameter such as aeh::ring.
+	// Same as MemoryArenaResource, deallocate does nothing and memory is freed through the arena.
+	template <typename T>
+	struct MemoryArenaAllocator
+	{
+		using value_type = T;
+
+		[[nodiscard]] MemoryArenaAllocator(MemoryArena & arena) noexcept : memory_arena(&arena) {}
+		template <typename U>
+		[[nodiscard]] MemoryArenaAllocator(MemoryArenaAllocator<U> const & other) noexcept : memory_arena(&other.arena()) {}
+
+		[[nodiscard]] auto allocate(size_t n) noexcept -> T * { return static_cast<T *>(memory_arena->allocate(n * sizeof(T), alignof(T))); }
+		auto deallocate(T *, size_t) noexcept -> void {}
+
+		[[nodiscard]] auto arena() const noexcept -> MemoryArena & { return *memory_arena; }
+
+		template <typename U>
+		[[nodiscard]] auto operator == (MemoryArenaAllocator<U> const & other) const noexcept -> bool { return memory_arena == &other.arena(); }
+
+	private:
+		MemoryArena * memory_arena;
+	};
+
 } // namespace aeh
@@ -84,18 +84,19 @@ namespace aeh::msp
         constexpr shared_ptr(std::nullptr_t) noexcept;
         explicit shared_ptr(shared<T> * object_to_take_ownership_of) noexcept;
         explicit shared_ptr(shared<T> * object_to_take_ownership_of, Deleter d) noexcept;
-        shared_ptr(shared_ptr<T> const & other) noexcept;
-        shared_ptr(shared_ptr<T> && other) noexcept;
+        shared_ptr(shared_ptr<T, Deleter> const & other) noexcept;
+        shared_ptr(shared_ptr<T, Deleter> && other) noexcept;
 
-        template <typename ... Args> 
+        // Only participates when T can be constructed from args, so that calls with an allocator and deleter don't end up here.
+        template <typename ... Args, typename = std::enable_if_t<std::is_constructible_v<T, Args...>>>
         [[nodiscard]] static auto make_new(Args && ... args) -> shared_ptr<T, Deleter>;
 
         template <typename Allocator, typename ... Args> 
         [[nodiscard]] static auto make_new(Allocator const & alloc, Deleter d, Args && ... args) -> shared_ptr<T, Deleter>;
 
-        auto operator = (shared_ptr<T> const & other) noexcept -> shared_ptr<T> &;
-        auto operator = (shared_ptr<T> && other) noexcept -> shared_ptr<T> &;
-        auto operator = (std::nullptr_t) noexcept -> shared_ptr<T> &;
+        auto operator = (shared_ptr<T, Deleter> const & other) noexcept -> shared_ptr<T, Deleter> &;
+        auto operator = (shared_ptr<T, Deleter> && other) noexcept -> shared_ptr<T, Deleter> &;
+        auto operator = (std::nullptr_t) noexcept -> shared_ptr<T, Deleter> &;
     };
 
     template <typename T, typename Deleter>
@@ -108,22 +109,22 @@ namespace aeh::msp
         constexpr shared_ptr(std::nullptr_t) noexcept;
         explicit shared_ptr(shared<T> * object_to_take_ownership_of) noexcept;
         explicit shared_ptr(shared<T> * object_to_take_ownership_of, Deleter d) noexcept;
-        shared_ptr(shared_ptr<T> const & other) noexcept;
-        shared_ptr(shared_ptr<T const> const & other) noexcept;
-        shared_ptr(shared_ptr<T> && other) noexcept;
-        shared_ptr(shared_ptr<T const> && other) noexcept;
+        shared_ptr(shared_ptr<T, Deleter> const & other) noexcept;
+        shared_ptr(shared_ptr<T const, Deleter> const & other) noexcept;
+        shared_ptr(shared_ptr<T, Deleter> && other) noexcept;
+        shared_ptr(shared_ptr<T const, Deleter> && other) noexcept;
 
-        template <typename ... Args> 
+        template <typename ... Args, typename = std::enable_if_t<std::is_constructible_v<T, Args...>>>
         [[nodiscard]] static auto make_new(Args && ... args) -> shared_ptr<T const, Deleter>;
 
         template <typename Allocator, typename ... Args> 
         [[nodiscard]] static auto make_new(Allocator const & alloc, Deleter d, Args && ... args) -> shared_ptr<T const, Deleter>;
 
-        auto operator = (shared_ptr<T const> const & other) noexcept -> shared_ptr<T const> &;
-        auto operator = (shared_ptr<T const> && other) noexcept -> shared_ptr<T const> &;
-        auto operator = (shared_ptr<T> const & other) noexcept -> shared_ptr<T const> &;
-        auto operator = (shared_ptr<T> && other) noexcept -> shared_ptr<T const> &;
-        auto operator = (std::nullptr_t) noexcept -> shared_ptr<T const> &;
+        auto operator = (shared_ptr<T const, Deleter> const & other) noexcept -> shared_ptr<T const, Deleter> &;
+        auto operator = (shared_ptr<T const, Deleter> && other) noexcept -> shared_ptr<T const, Deleter> &;
+        auto operator = (shared_ptr<T, Deleter> const & other) noexcept -> shared_ptr<T const, Deleter> &;
+        auto operator = (shared_ptr<T, Deleter> && other) noexcept -> shared_ptr<T const, Deleter> &;
+        auto operator = (std::nullptr_t) noexcept -> shared_ptr<T const, Deleter> &;
     };
 
     template <typename T, typename D> [[nodiscard]] constexpr auto operator == (shared_ptr<T, D> const & a, shared_ptr<T, D> const & b) noexcept -> bool;
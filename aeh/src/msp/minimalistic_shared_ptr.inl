@@ -118,21 +118,21 @@ namespace aeh::msp
     }
 
     template <typename T, typename Deleter>
-    shared_ptr<T, Deleter>::shared_ptr(shared_ptr<T> const & other) noexcept
+    shared_ptr<T, Deleter>::shared_ptr(shared_ptr<T, Deleter> const & other) noexcept
         : shared_ptr_base<T, Deleter>(other.deleter()) 
     { 
         this->take_ownership_of(other.shared_object); 
     }
 
     template <typename T, typename Deleter>
-    shared_ptr<T, Deleter>::shared_ptr(shared_ptr<T> && other) noexcept
+    shared_ptr<T, Deleter>::shared_ptr(shared_ptr<T, Deleter> && other) noexcept
         : shared_ptr_base<T, Deleter>(other.shared_object, std::move(other.deleter())) 
     {
         other.shared_object = nullptr; 
     }
 
     template <typename T, typename Deleter>
-    template <typename ... Args>
+    template <typename ... Args, typename>
     auto shared_ptr<T, Deleter>::make_new(Args && ... args) -> shared_ptr<T, Deleter> 
     {
         return shared_ptr<T, Deleter>(new shared<T>(std::forward<Args>(args)...)); 
@@ -148,21 +148,23 @@ namespace aeh::msp
     }
 
     template <typename T, typename Deleter>
-    auto shared_ptr<T, Deleter>::operator = (shared_ptr<T> const & other) noexcept -> shared_ptr<T> &
+    auto shared_ptr<T, Deleter>::operator = (shared_ptr<T, Deleter> const & other) noexcept -> shared_ptr<T, Deleter> &
     { 
         this->reset(other.shared_object);
+        if constexpr (!std::is_empty_v<Deleter>)
+            this->deleter() = other.deleter();
         return *this; 
     }
 
     template <typename T, typename Deleter>
-    auto shared_ptr<T, Deleter>::operator = (shared_ptr<T> && other) noexcept -> shared_ptr<T> &
+    auto shared_ptr<T, Deleter>::operator = (shared_ptr<T, Deleter> && other) noexcept -> shared_ptr<T, Deleter> &
     {
         shared_ptr(std::move(other)).swap(*this);
         return *this; 
     }
 
     template <typename T, typename Deleter>
-    auto shared_ptr<T, Deleter>::operator = (std::nullptr_t) noexcept -> shared_ptr<T> &
+    auto shared_ptr<T, Deleter>::operator = (std::nullptr_t) noexcept -> shared_ptr<T, Deleter> &
     {
         this->reset();
         return *this;
@@ -196,35 +198,35 @@ namespace aeh::msp
     }
 
     template <typename T, typename Deleter>
-    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T> const & other) noexcept 
+    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T, Deleter> const & other) noexcept 
         : shared_ptr_base<T const, Deleter>(other.deleter()) 
     {
         this->take_ownership_of(other.shared_object); 
     }
 
     template <typename T, typename Deleter>
-    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T const> const & other) noexcept
+    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T const, Deleter> const & other) noexcept
         : shared_ptr_base<T const, Deleter>(other.deleter())
     {
         this->take_ownership_of(other.shared_object);
     }
 
     template <typename T, typename Deleter>
-    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T> && other) noexcept
+    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T, Deleter> && other) noexcept
         : shared_ptr_base<T const, Deleter>(other.shared_object, std::move(other.deleter())) 
     {
         other.shared_object = nullptr; 
     }
 
     template <typename T, typename Deleter>
-    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T const> && other) noexcept
+    shared_ptr<T const, Deleter>::shared_ptr(shared_ptr<T const, Deleter> && other) noexcept
         : shared_ptr_base<T const, Deleter>(other.shared_object, std::move(other.deleter()))
     {
         other.shared_object = nullptr;
     }
 
     template <typename T, typename Deleter>
-    template <typename ... Args>
+    template <typename ... Args, typename>
     auto shared_ptr<T const, Deleter>::make_new(Args && ... args) -> shared_ptr<T const, Deleter>
     {
         return shared_ptr<T const, Deleter>(new shared<T>(std::forward<Args>(args)...)); 
@@ -240,35 +242,39 @@ namespace aeh::msp
     }
 
     template <typename T, typename Deleter>
-   auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T const> const & other) noexcept -> shared_ptr<T const> &
+   auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T const, Deleter> const & other) noexcept -> shared_ptr<T const, Deleter> &
     {
-        this->reset(other.shared_object); 
+        this->reset(other.shared_object);
+        if constexpr (!std::is_empty_v<Deleter>)
+            this->deleter() = other.deleter();
         return *this; 
     }
 
     template <typename T, typename Deleter>
-   auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T const> && other) noexcept -> shared_ptr<T const> &
+   auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T const, Deleter> && other) noexcept -> shared_ptr<T const, Deleter> &
     {
         shared_ptr(std::move(other)).swap(*this);
         return *this; 
     }
 
     template <typename T, typename Deleter>
-    auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T> const & other) noexcept -> shared_ptr<T const> &
+    auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T, Deleter> const & other) noexcept -> shared_ptr<T const, Deleter> &
     {
-        this->reset(other.shared_object); 
+        this->reset(other.shared_object);
+        if constexpr (!std::is_empty_v<Deleter>)
+            this->deleter() = other.deleter();
         return *this; 
     }
 
     template <typename T, typename Deleter>
-    auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T> && other) noexcept -> shared_ptr<T const> &
+    auto shared_ptr<T const, Deleter>::operator = (shared_ptr<T, Deleter> && other) noexcept -> shared_ptr<T const, Deleter> &
     {
         shared_ptr(std::move(other)).swap(*this);
         return *this; 
     }
 
     template <typename T, typename Deleter>
-    auto shared_ptr<T const, Deleter>::operator = (std::nullptr_t) noexcept -> shared_ptr<T const> &
+    auto shared_ptr<T const, Deleter>::operator = (std::nullptr_t) noexcept -> shared_ptr<T const, Deleter> &
     {
         this->reset();
         return *this;
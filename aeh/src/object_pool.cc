@@ -0,0 +1,174 @@
+#include "object_pool.hh"
+#include "debug/assert.hh"
+#include "internal/thread_local_cache.hh"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace aeh
+{
+
+	namespace
+	{
+		std::atomic<uint64_t> next_slab_allocator_id = 1;
+
+		// Magazines of the last few allocators the thread used, so that alternating between pools doesn't take the lock.
+		thread_local detail::ThreadLocalCache<void, 8> local_magazine_cache;
+	} // namespace
+
+	auto SlabAllocatorRef::allocate(size_t bytes) const noexcept -> void *
+	{
+		debug_assert_msg(bytes <= slab->object_size(), "Object too big for the slab");
+		return slab->allocate();
+	}
+
+	SlabAllocator::SlabAllocator(size_t object_size, size_t object_alignment, size_t max_object_count, SlabAllocatorOptions const & options) noexcept
+		: slot_size(align(std::max(object_size, sizeof(FreeObject)), std::max(object_alignment, alignof(FreeObject))))
+		, slot_count(max_object_count)
+		, magazine_size(std::max<size_t>(options.magazine_size, 2))
+		, magazine_count(options.max_thread_count)
+		, id(next_slab_allocator_id.fetch_add(1, std::memory_order_relaxed))
+	{
+		// Slots are aligned relative to the start of the region, which is aligned to a page.
+		debug_assert(object_alignment <= os_memory_page_size);
+
+		virtual_memory_region = VirtualMemoryRegion::reserve_bytes_of_virtual_memory(slot_size * slot_count, options.page_size);
+		if (magazine_count > 0)
+		{
+			magazines = std::make_unique<Magazine[]>(magazine_count);
+			magazine_storage = std::make_unique<void *[]>(magazine_count * magazine_size);
+			for (size_t i = 0; i < magazine_count; ++i)
+				magazines[i].objects = magazine_storage.get() + i * magazine_size;
+		}
+	}
+
+	auto SlabAllocator::allocate() noexcept -> void *
+	{
+		if (magazines == nullptr)
+			return allocate_from_free_list();
+
+		Magazine * const magazine = local_magazine();
+		if (magazine == nullptr)
+		{
+			auto const lock = std::lock_guard(mutex);
+			return allocate_from_free_list();
+		}
+
+		if (magazine->count == 0)
+		{
+			auto const lock = std::lock_guard(mutex);
+			for (void * object; magazine->count < magazine_size / 2 && (object = allocate_from_free_list()) != nullptr; )
+				magazine->objects[magazine->count++] = object;
+			if (magazine->count == 0)
+				return nullptr;
+		}
+
+		return magazine->objects[--magazine->count];
+	}
+
+	auto SlabAllocator::deallocate(void * object) noexcept -> void
+	{
+		debug_assert(object >= virtual_memory_region.memory_region_address() && object < static_cast<char *>(virtual_memory_region.memory_region_address()) + slot_size * slot_count);
+
+		if (magazines == nullptr)
+			return deallocate_to_free_list(object);
+
+		Magazine * const magazine = local_magazine();
+		if (magazine == nullptr)
+		{
+			auto const lock = std::lock_guard(mutex);
+			return deallocate_to_free_list(object);
+		}
+
+		if (magazine->count == magazine_size)
+		{
+			auto const lock = std::lock_guard(mutex);
+			while (magazine->count > magazine_size / 2)
+				deallocate_to_free_list(magazine->objects[--magazine->count]);
+		}
+
+		magazine->objects[magazine->count++] = object;
+	}
+
+	auto SlabAllocator::release_thread_cache() noexcept -> void
+	{
+		if (magazines == nullptr)
+			return;
+
+		local_magazine_cache.erase(id);
+
+		// Look for it even if it wasn't cached, since the cache entry may have been evicted.
+		auto const lock = std::lock_guard(mutex);
+		Magazine * const magazine = find_magazine_of_this_thread();
+		if (magazine == nullptr)
+			return;
+
+		while (magazine->count > 0)
+			deallocate_to_free_list(magazine->objects[--magazine->count]);
+		magazine->owner = std::thread::id();
+	}
+
+	auto SlabAllocator::local_magazine() noexcept -> Magazine *
+	{
+		if (auto const * const entry = local_magazine_cache.find(id))
+			return static_cast<Magazine *>(entry->value);
+
+		auto const lock = std::lock_guard(mutex);
+
+		// The thread may already have a magazine if its cache entry was evicted. Otherwise take one that was released or
+		// has never been used.
+		Magazine * magazine = find_magazine_of_this_thread();
+		if (magazine == nullptr)
+		{
+			for (size_t i = 0; i < used_magazine_count && magazine == nullptr; ++i)
+				if (magazines[i].owner == std::thread::id())
+					magazine = &magazines[i];
+			if (magazine == nullptr && used_magazine_count < magazine_count)
+				magazine = &magazines[used_magazine_count++];
+			if (magazine != nullptr)
+				magazine->owner = std::this_thread::get_id();
+		}
+
+		// Threads that didn't get a magazine are cached too, so that they don't look for one every time.
+		local_magazine_cache.insert(id, magazine);
+		return magazine;
+	}
+
+	auto SlabAllocator::find_magazine_of_this_thread() noexcept -> Magazine *
+	{
+		std::thread::id const this_thread = std::this_thread::get_id();
+		for (size_t i = 0; i < used_magazine_count; ++i)
+			if (magazines[i].owner == this_thread)
+				return &magazines[i];
+		return nullptr;
+	}
+
+	auto SlabAllocator::allocate_from_free_list() noexcept -> void *
+	{
+		if (free_list != nullptr)
+			return std::exchange(free_list, free_list->next);
+
+		if (first_unused_slot == slot_count)
+			return nullptr;
+
+		// Commit pages as the slab grows, doubling them like MemoryArena does.
+		size_t const end = (first_unused_slot + 1) * slot_size;
+		if (end > virtual_memory_region.physical_memory_size_in_bytes())
+		{
+			size_t const pages_needed = virtual_memory_region.align_to_page_boundary(end) / virtual_memory_region.page_size();
+			size_t const twice_the_current_pages = virtual_memory_region.physical_memory_size_in_pages() * 2;
+			size_t const new_page_count = std::max(pages_needed, std::min(twice_the_current_pages, virtual_memory_region.virtual_memory_size_in_pages()));
+			if (!virtual_memory_region.allocate_extra_pages_of_physical_memory(new_page_count - virtual_memory_region.physical_memory_size_in_pages()))
+				return nullptr;
+		}
+
+		return static_cast<char *>(virtual_memory_region.memory_region_address()) + slot_size * first_unused_slot++;
+	}
+
+	auto SlabAllocator::deallocate_to_free_list(void * object) noexcept -> void
+	{
+		free_list = ::new (object) FreeObject{free_list};
+	}
+
+} // namespace aeh
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "virtual_memory.hh"
+#include "align.hh"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace aeh
+{
+
+	struct SlabAllocator;
+
+	struct SlabAllocatorOptions
+	{
+		PageSize page_size = PageSize::os_default;
+		// With 0 the allocator is single threaded. Otherwise up to this many threads can allocate and deallocate at the
+		// same time, each through its own magazine of free objects that only goes to the shared free list, under a lock,
+		// once every magazine_size / 2 operations. Threads past max_thread_count take the lock every time.
+		// Objects in the magazine of a thread that exits are lost to other threads, unless it calls
+		// SlabAllocator::release_thread_cache() first.
+		size_t max_thread_count = 0;
+		size_t magazine_size = 64;
+	};
+
+	// Allocator and deleter in one, for msp::shared_ptr::make_new and other interfaces that take them by const reference.
+	// The slab must have room for the object, since allocate() returns nullptr when it is full.
+	struct SlabAllocatorRef
+	{
+		[[nodiscard]] auto allocate(size_t bytes) const noexcept -> void *;
+		template <typename T>
+		auto operator () (T * object) const noexcept -> void;
+
+		SlabAllocator * slab = nullptr;
+	};
+
+	// Allocates objects of a single size from a reserved region of virtual memory, committing pages as it needs them.
+	// Freed objects go to an intrusive free list, so both allocation and deallocation are O(1) in any order, and objects
+	// have no headers.
+	struct SlabAllocator
+	{
+		explicit SlabAllocator(size_t object_size, size_t object_alignment, size_t max_object_count, SlabAllocatorOptions const & options = SlabAllocatorOptions()) noexcept;
+		SlabAllocator(SlabAllocator const &) = delete;
+		SlabAllocator(SlabAllocator &&) = delete;
+		auto operator = (SlabAllocator const &) -> SlabAllocator & = delete;
+		auto operator = (SlabAllocator &&) -> SlabAllocator & = delete;
+
+		// Returns nullptr when max_object_count objects are allocated already.
+		[[nodiscard]] auto allocate() noexcept -> void *;
+		auto deallocate(void * object) noexcept -> void;
+
+		// Gives the objects in the calling thread's magazine back to the shared free list, and the magazine to whichever
+		// thread needs one next.
+		auto release_thread_cache() noexcept -> void;
+
+		[[nodiscard]] auto ref() noexcept -> SlabAllocatorRef { return SlabAllocatorRef{this}; }
+
+		[[nodiscard]] auto object_size() const noexcept -> size_t { return slot_size; }
+		[[nodiscard]] auto max_object_count() const noexcept -> size_t { return slot_count; }
+		[[nodiscard]] auto committed_bytes() const noexcept -> size_t { return virtual_memory_region.physical_memory_size_in_bytes(); }
+
+	private:
+		struct FreeObject
+		{
+			FreeObject * next;
+		};
+
+		struct alignas(cache_line_size) Magazine
+		{
+			std::thread::id owner;
+			size_t count = 0;
+			void ** objects = nullptr;
+		};
+
+		[[nodiscard]] auto local_magazine() noexcept -> Magazine *;
+		// Needs the lock.
+		[[nodiscard]] auto find_magazine_of_this_thread() noexcept -> Magazine *;
+		// These need the lock if there are magazines.
+		[[nodiscard]] auto allocate_from_free_list() noexcept -> void *;
+		auto deallocate_to_free_list(void * object) noexcept -> void;
+
+		VirtualMemoryRegion virtual_memory_region;
+		size_t slot_size;
+		size_t slot_count;
+		FreeObject * free_list = nullptr;
+		// Slots from this one on have never been allocated.
+		size_t first_unused_slot = 0;
+
+		size_t magazine_size;
+		size_t magazine_count;
+		std::unique_ptr<Magazine[]> magazines;
+		std::unique_ptr<void *[]> magazine_storage;
+		size_t used_magazine_count = 0;
+		std::mutex mutex;
+		// Tells allocators apart in the per-thread cache of magazines, even if one is created where a destroyed one used to be.
+		uint64_t id;
+	};
+
+	// Typed SlabAllocator that constructs and destroys the objects it allocates.
+	template <typename T>
+	struct ObjectPool
+	{
+		explicit ObjectPool(size_t max_object_count, SlabAllocatorOptions const & options = SlabAllocatorOptions()) noexcept
+			: slab(sizeof(T), alignof(T), max_object_count, options)
+		{}
+
+		// Returns nullptr if the pool is full. If the constructor of T throws, the memory goes back to the pool.
+		template <typename ... Args>
+		[[nodiscard]] auto create(Args && ... args) -> T *;
+		auto destroy(T * object) noexcept -> void;
+
+		[[nodiscard]] auto allocator() noexcept -> SlabAllocator & { return slab; }
+		[[nodiscard]] auto ref() noexcept -> SlabAllocatorRef { return slab.ref(); }
+
+	private:
+		SlabAllocator slab;
+	};
+
+} // namespace aeh
+
+#include "object_pool.inl"
@@ -0,0 +1,37 @@
+namespace aeh
+{
+
+	template <typename T>
+	auto SlabAllocatorRef::operator () (T * object) const noexcept -> void
+	{
+		std::destroy_at(object);
+		slab->deallocate(object);
+	}
+
+	template <typename T>
+	template <typename ... Args>
+	auto ObjectPool<T>::create(Args && ... args) -> T *
+	{
+		void * const memory = slab.allocate();
+		if (memory == nullptr)
+			return nullptr;
+
+		try
+		{
+			return ::new (memory) T(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			slab.deallocate(memory);
+			throw;
+		}
+	}
+
+	template <typename T>
+	auto ObjectPool<T>::destroy(T * object) noexcept -> void
+	{
+		std::destroy_at(object);
+		slab.deallocate(object);
+	}
+
+} // namespace aeh
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "batched_parallel_work.hh"
+#include <iterator>
+
+namespace aeh
+{
+
+	// Unordered counterparts of batched_parallel_work for when results don't need to be processed in order.
+	// The range is split in contiguous chunks that the calling thread and worker_count extra workers claim from
+	// a shared counter. The calling thread keeps claiming chunks until there are none left, so any executor
+	// accepted by batched_parallel_work works here too, including ones whose workers never get to run.
+
+	// Calls f on every element of [begin, end).
+	template <typename It, typename F, typename Executor = decltype(run_in_new_thread) const &> requires std::random_access_iterator<It>
+	void parallel_for(It begin, It end, size_t worker_count, F const & f, Executor && executor = run_in_new_thread);
+
+	// Writes f(begin[i]) to out[i] for every element of [begin, end). Returns the end of the output range.
+	template <typename It, typename Out, typename F, typename Executor = decltype(run_in_new_thread) const &>
+		requires std::random_access_iterator<It> && std::random_access_iterator<Out>
+	auto parallel_transform(It begin, It end, Out out, size_t worker_count, F const & f, Executor && executor = run_in_new_thread) -> Out;
+
+	// Same as std::transform_reduce. Each chunk is folded into a partial result of its own and partials are then
+	// combined pairwise in a tree. Chunks are always combined in range order, so reduce needs to be associative but
+	// not commutative, and the result doesn't depend on how chunks were distributed among workers.
+	template <typename It, typename T, typename Reduce, typename Transform, typename Executor = decltype(run_in_new_thread) const &>
+		requires std::random_access_iterator<It>
+	auto parallel_transform_reduce(It begin, It end, size_t worker_count, T init, Reduce const & reduce, Transform const & transform, Executor && executor = run_in_new_thread) -> T;
+
+} // namespace aeh
+
+#include "parallel_algorithm.inl"
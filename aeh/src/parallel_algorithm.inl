@@ -0,0 +1,115 @@
+#include <optional>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		// More chunks than threads so that a slow thread doesn't hold everyone else back.
+		constexpr size_t parallel_chunks_per_thread = 4;
+
+		inline auto parallel_chunk_count(size_t size, size_t worker_count) noexcept -> size_t
+		{
+			return std::min(size, (worker_count + 1) * parallel_chunks_per_thread);
+		}
+
+		// Calls chunk_function(chunk_index, begin, end) once for each of the chunk_count contiguous chunks [0, size) is split in.
+		template <typename ChunkFunction, typename Executor>
+		void parallel_chunks(size_t size, size_t chunk_count, size_t worker_count, ChunkFunction const & chunk_function, Executor && executor)
+		{
+			size_t const chunk_size = size / chunk_count;
+			size_t const excedent = size % chunk_count;
+			// The first excedent chunks are one element bigger.
+			auto const chunk_begin = [=](size_t chunk) { return chunk * chunk_size + std::min(chunk, excedent); };
+
+			SharedIndexScheduler scheduler(chunk_count, worker_count + 1, 1);
+			auto const run_chunks = [&]()
+			{
+				size_t begin, end;
+				while (scheduler.claim(0, begin, end))
+					for (size_t chunk = begin; chunk < end; ++chunk)
+						chunk_function(chunk, chunk_begin(chunk), chunk_begin(chunk + 1));
+			};
+
+			using worker_t = decltype(executor(run_chunks));
+			std::vector<worker_t> workers;
+			workers.reserve(worker_count);
+			for (size_t i = 0; i < worker_count; ++i)
+				workers.push_back(executor(run_chunks));
+
+			run_chunks();
+
+			for (worker_t & worker : workers)
+				worker.join();
+		}
+
+		// Padded so that workers writing the partials of neighbouring chunks don't share a cache line.
+		template <typename T>
+		struct alignas(cache_line_size) ParallelPartial
+		{
+			std::optional<T> value;
+		};
+	} // namespace detail
+
+	template <typename It, typename F, typename Executor> requires std::random_access_iterator<It>
+	void parallel_for(It begin, It end, size_t worker_count, F const & f, Executor && executor)
+	{
+		size_t const size = static_cast<size_t>(end - begin);
+		if (size == 0)
+			return;
+
+		detail::parallel_chunks(size, detail::parallel_chunk_count(size, worker_count), worker_count,
+			[&](size_t /*chunk*/, size_t chunk_begin, size_t chunk_end)
+			{
+				for (size_t i = chunk_begin; i < chunk_end; ++i)
+					f(begin[i]);
+			}, executor);
+	}
+
+	template <typename It, typename Out, typename F, typename Executor>
+		requires std::random_access_iterator<It> && std::random_access_iterator<Out>
+	auto parallel_transform(It begin, It end, Out out, size_t worker_count, F const & f, Executor && executor) -> Out
+	{
+		size_t const size = static_cast<size_t>(end - begin);
+		if (size == 0)
+			return out;
+
+		detail::parallel_chunks(size, detail::parallel_chunk_count(size, worker_count), worker_count,
+			[&](size_t /*chunk*/, size_t chunk_begin, size_t chunk_end)
+			{
+				for (size_t i = chunk_begin; i < chunk_end; ++i)
+					out[i] = f(begin[i]);
+			}, executor);
+
+		return out + size;
+	}
+
+	template <typename It, typename T, typename Reduce, typename Transform, typename Executor>
+		requires std::random_access_iterator<It>
+	auto parallel_transform_reduce(It begin, It end, size_t worker_count, T init, Reduce const & reduce, Transform const & transform, Executor && executor) -> T
+	{
+		size_t const size = static_cast<size_t>(end - begin);
+		if (size == 0)
+			return init;
+
+		// Chunks are never empty, so every partial gets a value.
+		size_t const chunk_count = detail::parallel_chunk_count(size, worker_count);
+		std::vector<detail::ParallelPartial<T>> partials(chunk_count);
+
+		detail::parallel_chunks(size, chunk_count, worker_count,
+			[&](size_t chunk, size_t chunk_begin, size_t chunk_end)
+			{
+				T partial = transform(begin[chunk_begin]);
+				for (size_t i = chunk_begin + 1; i < chunk_end; ++i)
+					partial = reduce(std::move(partial), transform(begin[i]));
+				partials[chunk].value.emplace(std::move(partial));
+			}, executor);
+
+		for (size_t stride = 1; stride < chunk_count; stride *= 2)
+			for (size_t i = 0; i + stride < chunk_count; i += 2 * stride)
+				partials[i].value.emplace(reduce(std::move(*partials[i].value), std::move(*partials[i + stride].value)));
+
+		return reduce(std::move(init), std::move(*partials[0].value));
+	}
+
+} // namespace aeh
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "fixed_capacity_vector.hh"
+#include "ring.hh" // std_allocator
+#include <initializer_list>
+#include <memory>
+#include <span>
+
+namespace aeh
+{
+
+	// Vector that keeps up to N elements inline, in a fixed_capacity_vector, and moves them to a buffer from Allocator
+	// when it grows past that. Small sizes don't allocate and trivially copyable elements are copied with
+	// fixed_capacity_vector's trivial copy while they are inline. Once on the heap, elements stay there until
+	// shrink_to_fit, so pointers and iterators are invalidated like in std::vector when the capacity changes.
+	template <typename T, size_t N, std_allocator<T> Allocator = std::allocator<T>>
+	struct small_vector
+	{
+		using value_type = T;
+		using iterator = T *;
+		using const_iterator = T const *;
+		using reverse_iterator = std::reverse_iterator<iterator>;
+		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+		using size_type = size_t;
+		using allocator_type = Allocator;
+
+		small_vector() noexcept = default;
+		explicit small_vector(Allocator allocator) noexcept;
+		small_vector(std::initializer_list<T> ilist, Allocator allocator = Allocator());
+		~small_vector();
+
+		small_vector(small_vector const & other) requires(std::is_copy_constructible_v<T>);
+		small_vector(small_vector && other) noexcept(std::is_nothrow_move_constructible_v<T>);
+		auto operator = (small_vector const & other) -> small_vector & requires(std::is_copy_constructible_v<T>);
+		auto operator = (small_vector && other) noexcept(std::is_nothrow_move_constructible_v<T>) -> small_vector &;
+
+		[[nodiscard]] auto size() const noexcept -> size_t;
+		[[nodiscard]] auto ssize() const noexcept -> ptrdiff_t;
+		[[nodiscard]] auto int_size() const noexcept -> int;
+		[[nodiscard]] auto empty() const noexcept -> bool;
+		[[nodiscard]] auto capacity() const noexcept -> size_t;
+		[[nodiscard]] static constexpr auto inline_capacity() noexcept -> size_t { return N; }
+		// Whether the elements are stored inline, and so whether moving the vector moves each element.
+		[[nodiscard]] auto is_inline() const noexcept -> bool { return heap_elements == nullptr; }
+		[[nodiscard]] auto data() noexcept -> T *;
+		[[nodiscard]] auto data() const noexcept -> T const *;
+		[[nodiscard]] auto operator [] (size_t i) noexcept -> T &;
+		[[nodiscard]] auto operator [] (size_t i) const noexcept -> T const &;
+		[[nodiscard]] auto front() noexcept -> T &;
+		[[nodiscard]] auto front() const noexcept -> T const &;
+		[[nodiscard]] auto back() noexcept -> T &;
+		[[nodiscard]] auto back() const noexcept -> T const &;
+
+		[[nodiscard]] auto begin() noexcept -> iterator;
+		[[nodiscard]] auto end() noexcept -> iterator;
+		[[nodiscard]] auto begin() const noexcept -> const_iterator;
+		[[nodiscard]] auto end() const noexcept -> const_iterator;
+		[[nodiscard]] auto cbegin() const noexcept -> const_iterator;
+		[[nodiscard]] auto cend() const noexcept -> const_iterator;
+
+		[[nodiscard]] auto rbegin() noexcept -> reverse_iterator;
+		[[nodiscard]] auto rend() noexcept -> reverse_iterator;
+		[[nodiscard]] auto rbegin() const noexcept -> const_reverse_iterator;
+		[[nodiscard]] auto rend() const noexcept -> const_reverse_iterator;
+		[[nodiscard]] auto crbegin() const noexcept -> const_reverse_iterator;
+		[[nodiscard]] auto crend() const noexcept -> const_reverse_iterator;
+
+		[[nodiscard]] auto nth(size_t i) noexcept -> iterator;
+		[[nodiscard]] auto nth(size_t i) const noexcept -> const_iterator;
+
+		operator std::span<T>() noexcept;
+		operator std::span<T const>() const noexcept;
+
+		auto clear() noexcept -> void;
+		auto push_back(T const & t) -> T &;
+		auto push_back(T && t) -> T &;
+		template <typename ... Args> auto emplace_back(Args && ... args) -> T &;
+		auto pop_back() noexcept -> void;
+		auto resize(size_t new_size) -> void;
+		auto resize(size_t new_size, T const & value) -> void;
+		auto erase(const_iterator pos) noexcept -> iterator;
+		auto erase(const_iterator first, const_iterator last) noexcept -> const_iterator;
+
+		template <std::ranges::input_range R>
+		auto assign(R const & range) -> void requires(std::is_constructible_v<T, std::ranges::range_value_t<R>>);
+
+		template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+		auto assign(It first, Sentinel last) -> void requires(std::is_constructible_v<T, std::iter_value_t<It>>);
+
+		auto reserve(size_t new_capacity) -> void;
+		// Moves the elements back inline if they fit, or else to a buffer of exactly size() elements.
+		auto shrink_to_fit() -> void;
+
+		[[nodiscard]] auto get_allocator() const noexcept -> Allocator { return allocator_; }
+
+	private:
+		// Moves the elements to a new heap buffer.
+		auto move_to_heap(size_t new_capacity) -> void;
+		// Constructs the elements in new_elements, leaving them in place. Frees nothing.
+		auto relocate_to(T * new_elements) -> void;
+		auto free_heap_elements() noexcept -> void;
+		template <typename ... Args> auto grow_and_emplace_back(Args && ... args) -> T &;
+
+		fixed_capacity_vector<T, N> inline_elements;
+		// Null while elements are inline.
+		T * heap_elements = nullptr;
+		size_t heap_size = 0;
+		size_t heap_capacity = 0;
+		[[no_unique_address]] Allocator allocator_;
+	};
+
+	template <typename T, size_t N, typename Allocator>
+	[[nodiscard]] auto operator == (small_vector<T, N, Allocator> const & a, small_vector<T, N, Allocator> const & b) noexcept -> bool;
+
+	template <typename T, size_t N, typename Allocator>
+	[[nodiscard]] auto operator <=> (small_vector<T, N, Allocator> const & a, small_vector<T, N, Allocator> const & b) noexcept;
+
+} // namespace aeh
+
+#include "small_vector.inl"
@@ -0,0 +1,542 @@
+#include <algorithm>
+#include <utility>
+
+namespace aeh
+{
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	small_vector<T, N, Allocator>::small_vector(Allocator allocator) noexcept
+		: allocator_(std::move(allocator))
+	{}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	small_vector<T, N, Allocator>::small_vector(std::initializer_list<T> ilist, Allocator allocator)
+		: allocator_(std::move(allocator))
+	{
+		reserve(ilist.size());
+		assign(ilist.begin(), ilist.end());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	small_vector<T, N, Allocator>::~small_vector()
+	{
+		free_heap_elements();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	small_vector<T, N, Allocator>::small_vector(small_vector const & other) requires(std::is_copy_constructible_v<T>)
+		: inline_elements(other.is_inline() ? other.inline_elements : fixed_capacity_vector<T, N>())
+		, allocator_(other.allocator_)
+	{
+		if (!other.is_inline())
+		{
+			reserve(other.size());
+			assign(other.begin(), other.end());
+		}
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	small_vector<T, N, Allocator>::small_vector(small_vector && other) noexcept(std::is_nothrow_move_constructible_v<T>)
+		: inline_elements(std::move(other.inline_elements))
+		, heap_elements(std::exchange(other.heap_elements, nullptr))
+		, heap_size(std::exchange(other.heap_size, 0))
+		, heap_capacity(std::exchange(other.heap_capacity, 0))
+		, allocator_(other.allocator_)
+	{
+		other.inline_elements.clear();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::operator = (small_vector const & other) -> small_vector & requires(std::is_copy_constructible_v<T>)
+	{
+		if (this == &other)
+			return *this;
+
+		if (is_inline() && other.is_inline())
+		{
+			inline_elements = other.inline_elements;
+			return *this;
+		}
+
+		clear();
+		reserve(other.size());
+		assign(other.begin(), other.end());
+		return *this;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::operator = (small_vector && other) noexcept(std::is_nothrow_move_constructible_v<T>) -> small_vector &
+	{
+		if (this == &other)
+			return *this;
+
+		free_heap_elements();
+		inline_elements = std::move(other.inline_elements);
+		other.inline_elements.clear();
+		heap_elements = std::exchange(other.heap_elements, nullptr);
+		heap_size = std::exchange(other.heap_size, 0);
+		heap_capacity = std::exchange(other.heap_capacity, 0);
+		allocator_ = other.allocator_;
+		return *this;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::size() const noexcept -> size_t
+	{
+		return is_inline() ? inline_elements.size() : heap_size;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::ssize() const noexcept -> ptrdiff_t
+	{
+		return ptrdiff_t(size());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::int_size() const noexcept -> int
+	{
+		debug_assert(size() <= size_t(std::numeric_limits<int>::max()));
+		return int(size());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::empty() const noexcept -> bool
+	{
+		return size() == 0;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::capacity() const noexcept -> size_t
+	{
+		return is_inline() ? N : heap_capacity;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::data() noexcept -> T *
+	{
+		return is_inline() ? inline_elements.data() : heap_elements;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::data() const noexcept -> T const *
+	{
+		return is_inline() ? inline_elements.data() : heap_elements;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::operator [] (size_t i) noexcept -> T &
+	{
+		debug_assert(i < size());
+		return data()[i];
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::operator [] (size_t i) const noexcept -> T const &
+	{
+		debug_assert(i < size());
+		return data()[i];
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::front() noexcept -> T &
+	{
+		return (*this)[0];
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::front() const noexcept -> T const &
+	{
+		return (*this)[0];
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::back() noexcept -> T &
+	{
+		return (*this)[size() - 1];
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::back() const noexcept -> T const &
+	{
+		return (*this)[size() - 1];
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::begin() noexcept -> iterator
+	{
+		return data();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::end() noexcept -> iterator
+	{
+		return data() + size();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::begin() const noexcept -> const_iterator
+	{
+		return cbegin();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::end() const noexcept -> const_iterator
+	{
+		return cend();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::cbegin() const noexcept -> const_iterator
+	{
+		return data();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::cend() const noexcept -> const_iterator
+	{
+		return data() + size();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::rbegin() noexcept -> reverse_iterator
+	{
+		return reverse_iterator(end());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::rend() noexcept -> reverse_iterator
+	{
+		return reverse_iterator(begin());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::rbegin() const noexcept -> const_reverse_iterator
+	{
+		return crbegin();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::rend() const noexcept -> const_reverse_iterator
+	{
+		return crend();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::crbegin() const noexcept -> const_reverse_iterator
+	{
+		return const_reverse_iterator(cend());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::crend() const noexcept -> const_reverse_iterator
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::nth(size_t i) noexcept -> iterator
+	{
+		debug_assert(i <= size());
+		return begin() + i;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::nth(size_t i) const noexcept -> const_iterator
+	{
+		debug_assert(i <= size());
+		return begin() + i;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	small_vector<T, N, Allocator>::operator std::span<T>() noexcept
+	{
+		return std::span<T>(data(), size());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	small_vector<T, N, Allocator>::operator std::span<T const>() const noexcept
+	{
+		return std::span<T const>(data(), size());
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::clear() noexcept -> void
+	{
+		if (is_inline())
+		{
+			inline_elements.clear();
+		}
+		else
+		{
+			std::destroy_n(heap_elements, heap_size);
+			heap_size = 0;
+		}
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::push_back(T const & t) -> T &
+	{
+		return emplace_back(t);
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::push_back(T && t) -> T &
+	{
+		return emplace_back(std::move(t));
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	template <typename ... Args>
+	auto small_vector<T, N, Allocator>::emplace_back(Args && ... args) -> T &
+	{
+		if (is_inline())
+		{
+			if (inline_elements.size() < N)
+				return inline_elements.emplace_back(std::forward<Args>(args)...);
+		}
+		else if (heap_size < heap_capacity)
+		{
+			T * const new_element = std::construct_at(heap_elements + heap_size, std::forward<Args>(args)...);
+			heap_size++;
+			return *new_element;
+		}
+
+		return grow_and_emplace_back(std::forward<Args>(args)...);
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	template <typename ... Args>
+	auto small_vector<T, N, Allocator>::grow_and_emplace_back(Args && ... args) -> T &
+	{
+		// Construct the new element before moving the old ones, since args may refer to one of them.
+		size_t const old_size = size();
+		size_t const new_capacity = 2 * capacity();
+		T * const new_elements = allocator_.allocate(new_capacity);
+		try
+		{
+			std::construct_at(new_elements + old_size, std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			allocator_.deallocate(new_elements, new_capacity);
+			throw;
+		}
+
+		try
+		{
+			relocate_to(new_elements);
+		}
+		catch (...)
+		{
+			std::destroy_at(new_elements + old_size);
+			allocator_.deallocate(new_elements, new_capacity);
+			throw;
+		}
+
+		clear();
+		free_heap_elements();
+		heap_elements = new_elements;
+		heap_size = old_size + 1;
+		heap_capacity = new_capacity;
+		return heap_elements[old_size];
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::pop_back() noexcept -> void
+	{
+		if (is_inline())
+		{
+			inline_elements.pop_back();
+		}
+		else
+		{
+			debug_assert(heap_size > 0);
+			std::destroy_at(heap_elements + heap_size - 1);
+			heap_size--;
+		}
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::resize(size_t new_size) -> void
+	{
+		if (new_size > capacity())
+			reserve(std::max(new_size, 2 * capacity()));
+
+		if (is_inline())
+		{
+			inline_elements.resize(new_size);
+		}
+		else
+		{
+			if (new_size < heap_size)
+				std::destroy(heap_elements + new_size, heap_elements + heap_size);
+			else
+				std::uninitialized_default_construct(heap_elements + heap_size, heap_elements + new_size);
+			heap_size = new_size;
+		}
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::resize(size_t new_size, T const & value) -> void
+	{
+		if (new_size > capacity())
+			reserve(std::max(new_size, 2 * capacity()));
+
+		if (is_inline())
+		{
+			inline_elements.resize(new_size, value);
+		}
+		else
+		{
+			if (new_size < heap_size)
+				std::destroy(heap_elements + new_size, heap_elements + heap_size);
+			else
+				std::uninitialized_fill(heap_elements + heap_size, heap_elements + new_size, value);
+			heap_size = new_size;
+		}
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::erase(const_iterator pos) noexcept -> iterator
+	{
+		if (is_inline())
+			return inline_elements.erase(pos);
+
+		debug_assert(pos >= begin() && pos < end());
+		iterator const pos_mutable = nth(pos - begin());
+		std::rotate(pos_mutable, pos_mutable + 1, end());
+		std::destroy_at(&back());
+		heap_size--;
+		return pos_mutable;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::erase(const_iterator first, const_iterator last) noexcept -> const_iterator
+	{
+		if (is_inline())
+			return inline_elements.erase(first, last);
+
+		ptrdiff_t const n = std::distance(first, last);
+		if (n <= 0)
+			return nth(first - begin());
+
+		debug_assert(first >= begin() && first < end());
+		debug_assert(last > begin() && last <= end());
+		iterator const first_mutable = nth(first - begin());
+		iterator const first_to_destroy = std::rotate(first_mutable, first_mutable + n, end());
+		std::destroy_n(first_to_destroy, n);
+		heap_size -= n;
+		return first_mutable;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	template <std::ranges::input_range R>
+	auto small_vector<T, N, Allocator>::assign(R const & range) -> void requires(std::is_constructible_v<T, std::ranges::range_value_t<R>>)
+	{
+		if constexpr (std::ranges::sized_range<R>)
+			reserve(std::ranges::size(range));
+		assign(std::ranges::begin(range), std::ranges::end(range));
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+	auto small_vector<T, N, Allocator>::assign(It first, Sentinel last) -> void requires(std::is_constructible_v<T, std::iter_value_t<It>>)
+	{
+		clear();
+		for (It it = first; it != last; ++it)
+			emplace_back(*it);
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::reserve(size_t new_capacity) -> void
+	{
+		if (new_capacity > capacity())
+			move_to_heap(new_capacity);
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::shrink_to_fit() -> void
+	{
+		if (is_inline() || heap_size == heap_capacity)
+			return;
+
+		if (heap_size > N)
+		{
+			move_to_heap(heap_size);
+			return;
+		}
+
+		// The heap buffer stays the owner of the elements until all of them have been moved inline, so that a
+		// throwing move leaves the vector as it was instead of leaking the buffer.
+		try
+		{
+			inline_elements.assign(std::make_move_iterator(heap_elements), std::make_move_iterator(heap_elements + heap_size));
+		}
+		catch (...)
+		{
+			inline_elements.clear();
+			throw;
+		}
+		free_heap_elements();
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::move_to_heap(size_t new_capacity) -> void
+	{
+		debug_assert(new_capacity >= size());
+		T * const new_elements = allocator_.allocate(new_capacity);
+		size_t const old_size = size();
+		try
+		{
+			relocate_to(new_elements);
+		}
+		catch (...)
+		{
+			allocator_.deallocate(new_elements, new_capacity);
+			throw;
+		}
+
+		clear();
+		free_heap_elements();
+		heap_elements = new_elements;
+		heap_size = old_size;
+		heap_capacity = new_capacity;
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::relocate_to(T * new_elements) -> void
+	{
+		// Same as std::vector, copy elements whose move may throw, so that the old ones are intact if it does.
+		// std::uninitialized_move and std::uninitialized_copy destroy what they constructed before throwing.
+		if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>)
+			std::uninitialized_move(begin(), end(), new_elements);
+		else
+			std::uninitialized_copy(begin(), end(), new_elements);
+	}
+
+	template <typename T, size_t N, std_allocator<T> Allocator>
+	auto small_vector<T, N, Allocator>::free_heap_elements() noexcept -> void
+	{
+		if (is_inline())
+			return;
+
+		std::destroy_n(heap_elements, heap_size);
+		allocator_.deallocate(heap_elements, heap_capacity);
+		heap_elements = nullptr;
+		heap_size = 0;
+		heap_capacity = 0;
+	}
+
+	template <typename T, size_t N, typename Allocator>
+	auto operator == (small_vector<T, N, Allocator> const & a, small_vector<T, N, Allocator> const & b) noexcept -> bool
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end());
+	}
+
+	template <typename T, size_t N, typename Allocator>
+	auto operator <=> (small_vector<T, N, Allocator> const & a, small_vector<T, N, Allocator> const & b) noexcept
+	{
+		return std::lexicographical_compare_three_way(a.begin(), a.end(), b.begin(), b.end());
+	}
+
+} // namespace aeh
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "tuple.hh"
+#include "debug/assert.hh"
+#include <algorithm>
+#include <concepts>
+#include <initializer_list>
+#include <iterator>
+#include <span>
+#include <tuple>
+#include <type_traits>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		template <typename ... Ts>
+		struct SoaVectorIterator
+		{
+			// Legacy iterators past input iterators must dereference to a real reference, which a proxy isn't.
+			using iterator_concept = std::random_access_iterator_tag;
+			using iterator_category = std::input_iterator_tag;
+			using difference_type = ptrdiff_t;
+			using value_type = std::tuple<std::remove_const_t<Ts>...>;
+			using reference = std::tuple<Ts &...>;
+
+			// Dereferencing returns a tuple of references by value, so -> needs something to point to.
+			struct pointer
+			{
+				reference ref;
+				auto operator -> () noexcept -> reference * { return &ref; }
+			};
+
+			SoaVectorIterator() noexcept = default;
+			SoaVectorIterator(std::tuple<Ts *...> columns_, size_t index_) noexcept : columns(columns_), index(index_) {}
+			template <typename ... Us> requires(std::is_same_v<Ts, Us const> && ...)
+			SoaVectorIterator(SoaVectorIterator<Us...> other) noexcept : columns(other.columns), index(other.index) {}
+
+			[[nodiscard]] auto operator * () const noexcept -> reference;
+			[[nodiscard]] auto operator -> () const noexcept -> pointer { return {**this}; }
+			[[nodiscard]] auto operator [] (difference_type i) const noexcept -> reference { return *(*this + i); }
+
+			auto operator ++ () noexcept -> SoaVectorIterator & { ++index; return *this; }
+			auto operator ++ (int) noexcept -> SoaVectorIterator { auto const old = *this; ++index; return old; }
+			auto operator -- () noexcept -> SoaVectorIterator & { --index; return *this; }
+			auto operator -- (int) noexcept -> SoaVectorIterator { auto const old = *this; --index; return old; }
+			auto operator += (difference_type n) noexcept -> SoaVectorIterator & { index += static_cast<size_t>(n); return *this; }
+			auto operator -= (difference_type n) noexcept -> SoaVectorIterator & { index -= static_cast<size_t>(n); return *this; }
+			[[nodiscard]] friend auto operator + (SoaVectorIterator it, difference_type n) noexcept -> SoaVectorIterator { return it += n; }
+			[[nodiscard]] friend auto operator + (difference_type n, SoaVectorIterator it) noexcept -> SoaVectorIterator { return it += n; }
+			[[nodiscard]] friend auto operator - (SoaVectorIterator it, difference_type n) noexcept -> SoaVectorIterator { return it -= n; }
+			[[nodiscard]] friend auto operator - (SoaVectorIterator a, SoaVectorIterator b) noexcept -> difference_type
+			{
+				return static_cast<difference_type>(a.index) - static_cast<difference_type>(b.index);
+			}
+
+			[[nodiscard]] friend auto operator == (SoaVectorIterator a, SoaVectorIterator b) noexcept -> bool { return a.index == b.index; }
+			[[nodiscard]] friend auto operator <=> (SoaVectorIterator a, SoaVectorIterator b) noexcept { return a.index <=> b.index; }
+
+			std::tuple<Ts *...> columns;
+			size_t index = 0;
+		};
+	} // namespace detail
+
+	// Structure of arrays. Stores a sequence of tuples of Ts, with every member in its own contiguous column, so
+	// that iterating over one member doesn't bring the rest into cache. All columns live in a single allocation,
+	// one after the other, and grow together. Elements are accessed through proxy references, tuples of references
+	// to one element of each column, and each column can be seen as a span.
+	// Elements are relocated on growth, which is why every type must be nothrow move constructible.
+	template <typename ... Ts>
+	struct soa_vector
+	{
+		static_assert(sizeof...(Ts) > 0, "soa_vector needs at least one column.");
+		static_assert((std::is_nothrow_move_constructible_v<Ts> && ...), "Columns of soa_vector must be nothrow move constructible.");
+		static_assert(((std::is_object_v<Ts> && !std::is_const_v<Ts>) && ...), "Columns of soa_vector must be non const object types.");
+
+		using value_type = std::tuple<Ts...>;
+		using reference = std::tuple<Ts &...>;
+		using const_reference = std::tuple<Ts const &...>;
+		using iterator = detail::SoaVectorIterator<Ts...>;
+		using const_iterator = detail::SoaVectorIterator<Ts const...>;
+		using size_type = size_t;
+
+		template <size_t I>
+		using column_type = std::tuple_element_t<I, value_type>;
+
+		static constexpr size_t column_count = sizeof...(Ts);
+
+		soa_vector() noexcept = default;
+		soa_vector(std::initializer_list<value_type> ilist);
+		~soa_vector();
+
+		soa_vector(soa_vector const & other) requires(std::is_copy_constructible_v<Ts> && ...);
+		soa_vector(soa_vector && other) noexcept;
+		auto operator = (soa_vector const & other) -> soa_vector & requires(std::is_copy_constructible_v<Ts> && ...);
+		auto operator = (soa_vector && other) noexcept -> soa_vector &;
+
+		[[nodiscard]] auto size() const noexcept -> size_t { return size_; }
+		[[nodiscard]] auto ssize() const noexcept -> ptrdiff_t { return static_cast<ptrdiff_t>(size_); }
+		[[nodiscard]] auto empty() const noexcept -> bool { return size_ == 0; }
+		[[nodiscard]] auto capacity() const noexcept -> size_t { return capacity_; }
+
+		[[nodiscard]] auto operator [] (size_t i) noexcept -> reference;
+		[[nodiscard]] auto operator [] (size_t i) const noexcept -> const_reference;
+		[[nodiscard]] auto front() noexcept -> reference;
+		[[nodiscard]] auto front() const noexcept -> const_reference;
+		[[nodiscard]] auto back() noexcept -> reference;
+		[[nodiscard]] auto back() const noexcept -> const_reference;
+
+		// Contiguous view of the Ith member of every element.
+		template <size_t I> [[nodiscard]] auto column() noexcept -> std::span<column_type<I>>;
+		template <size_t I> [[nodiscard]] auto column() const noexcept -> std::span<column_type<I> const>;
+		// Tuple with a span for every column.
+		[[nodiscard]] auto columns() noexcept -> std::tuple<std::span<Ts>...>;
+		[[nodiscard]] auto columns() const noexcept -> std::tuple<std::span<Ts const>...>;
+
+		[[nodiscard]] auto begin() noexcept -> iterator;
+		[[nodiscard]] auto end() noexcept -> iterator;
+		[[nodiscard]] auto begin() const noexcept -> const_iterator;
+		[[nodiscard]] auto end() const noexcept -> const_iterator;
+		[[nodiscard]] auto cbegin() const noexcept -> const_iterator;
+		[[nodiscard]] auto cend() const noexcept -> const_iterator;
+
+		auto clear() noexcept -> void;
+		auto reserve(size_t new_capacity) -> void;
+		auto shrink_to_fit() -> void;
+		auto resize(size_t new_size) -> void requires(std::is_default_constructible_v<Ts> && ...);
+		auto push_back(value_type const & value) -> reference;
+		auto push_back(value_type && value) -> reference;
+		// Takes one argument per column. Builds a value_type from them and then moves each member into its column.
+		template <typename ... Args> requires(sizeof...(Args) == sizeof...(Ts))
+		auto emplace_back(Args && ... args) -> reference;
+		auto pop_back() noexcept -> void;
+		// Removes the element at i by moving the last element into its place. Doesn't preserve order.
+		auto swap_and_pop(size_t i) noexcept((std::is_nothrow_move_assignable_v<Ts> && ...)) -> void;
+
+		[[nodiscard]] auto operator == (soa_vector const & other) const noexcept -> bool requires(std::equality_comparable<Ts> && ...);
+
+	private:
+		// Size in bytes of a block big enough for every column, each one aligned for its type.
+		[[nodiscard]] static auto block_size_for(size_t capacity) noexcept -> size_t;
+		[[nodiscard]] static constexpr auto block_alignment() noexcept -> size_t { return std::max({alignof(Ts)...}); }
+		[[nodiscard]] static auto allocate_columns(size_t capacity) -> std::tuple<Ts *...>;
+		static auto free_columns(std::tuple<Ts *...> columns, size_t capacity) noexcept -> void;
+		auto destroy_elements() noexcept -> void;
+		auto relocate_to_capacity(size_t new_capacity) -> void;
+		auto grow_if_full() -> void;
+
+		std::tuple<Ts *...> columns_;
+		size_t size_ = 0;
+		size_t capacity_ = 0;
+	};
+
+} // namespace aeh
+
+#include "soa_vector.inl"
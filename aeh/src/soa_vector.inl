@@ -0,0 +1,358 @@
+#include "align.hh"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		template <typename ... Ts>
+		auto SoaVectorIterator<Ts...>::operator * () const noexcept -> reference
+		{
+			// make_tuple unwraps reference_wrapper, which turns a tuple of std::ref into a tuple of references.
+			return transform_tuple(columns, [i = index](auto * column) { return std::ref(column[i]); });
+		}
+	} // namespace detail
+
+	template <typename ... Ts>
+	soa_vector<Ts...>::soa_vector(std::initializer_list<value_type> ilist)
+	{
+		reserve(ilist.size());
+		for (value_type const & value : ilist)
+			push_back(value);
+	}
+
+	template <typename ... Ts>
+	soa_vector<Ts...>::~soa_vector()
+	{
+		destroy_elements();
+		free_columns(columns_, capacity_);
+	}
+
+	template <typename ... Ts>
+	soa_vector<Ts...>::soa_vector(soa_vector const & other) requires(std::is_copy_constructible_v<Ts> && ...)
+	{
+		if (other.empty())
+			return;
+
+		std::tuple<Ts *...> const new_columns = allocate_columns(other.size_);
+		size_t copied_columns = 0;
+		try
+		{
+			for_each_in_tuple(other.columns_, new_columns, [&](auto * source, auto * destination)
+			{
+				std::uninitialized_copy_n(source, other.size_, destination);
+				++copied_columns;
+			});
+		}
+		catch (...)
+		{
+			for (size_t i = 0; i < copied_columns; ++i)
+				tuple_at(new_columns, i, [&](auto * column) { std::destroy_n(column, other.size_); });
+			free_columns(new_columns, other.size_);
+			throw;
+		}
+
+		columns_ = new_columns;
+		size_ = other.size_;
+		capacity_ = other.size_;
+	}
+
+	template <typename ... Ts>
+	soa_vector<Ts...>::soa_vector(soa_vector && other) noexcept
+		: columns_(std::exchange(other.columns_, std::tuple<Ts *...>()))
+		, size_(std::exchange(other.size_, 0))
+		, capacity_(std::exchange(other.capacity_, 0))
+	{}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::operator = (soa_vector const & other) -> soa_vector & requires(std::is_copy_constructible_v<Ts> && ...)
+	{
+		if (this != &other)
+			*this = soa_vector(other);
+		return *this;
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::operator = (soa_vector && other) noexcept -> soa_vector &
+	{
+		if (this != &other)
+		{
+			destroy_elements();
+			free_columns(columns_, capacity_);
+			columns_ = std::exchange(other.columns_, std::tuple<Ts *...>());
+			size_ = std::exchange(other.size_, 0);
+			capacity_ = std::exchange(other.capacity_, 0);
+		}
+		return *this;
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::operator [] (size_t i) noexcept -> reference
+	{
+		debug_assert(i < size());
+		return *(begin() + static_cast<ptrdiff_t>(i));
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::operator [] (size_t i) const noexcept -> const_reference
+	{
+		debug_assert(i < size());
+		return *(begin() + static_cast<ptrdiff_t>(i));
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::front() noexcept -> reference
+	{
+		return (*this)[0];
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::front() const noexcept -> const_reference
+	{
+		return (*this)[0];
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::back() noexcept -> reference
+	{
+		return (*this)[size() - 1];
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::back() const noexcept -> const_reference
+	{
+		return (*this)[size() - 1];
+	}
+
+	template <typename ... Ts>
+	template <size_t I>
+	auto soa_vector<Ts...>::column() noexcept -> std::span<column_type<I>>
+	{
+		return {std::get<I>(columns_), size_};
+	}
+
+	template <typename ... Ts>
+	template <size_t I>
+	auto soa_vector<Ts...>::column() const noexcept -> std::span<column_type<I> const>
+	{
+		return {std::get<I>(columns_), size_};
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::columns() noexcept -> std::tuple<std::span<Ts>...>
+	{
+		return transform_tuple(columns_, [this](auto * column) { return std::span(column, size_); });
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::columns() const noexcept -> std::tuple<std::span<Ts const>...>
+	{
+		return transform_tuple(columns_, [this](auto * column)
+		{
+			using T = std::remove_pointer_t<decltype(column)>;
+			return std::span<T const>(column, size_);
+		});
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::begin() noexcept -> iterator
+	{
+		return iterator(columns_, 0);
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::end() noexcept -> iterator
+	{
+		return iterator(columns_, size_);
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::begin() const noexcept -> const_iterator
+	{
+		return const_iterator(columns_, 0);
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::end() const noexcept -> const_iterator
+	{
+		return const_iterator(columns_, size_);
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::cbegin() const noexcept -> const_iterator
+	{
+		return begin();
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::cend() const noexcept -> const_iterator
+	{
+		return end();
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::clear() noexcept -> void
+	{
+		destroy_elements();
+		size_ = 0;
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::reserve(size_t new_capacity) -> void
+	{
+		if (new_capacity > capacity_)
+			relocate_to_capacity(new_capacity);
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::shrink_to_fit() -> void
+	{
+		if (size_ < capacity_)
+			relocate_to_capacity(size_);
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::resize(size_t new_size) -> void requires(std::is_default_constructible_v<Ts> && ...)
+	{
+		if (new_size < size_)
+		{
+			for_each_in_tuple(columns_, [&](auto * column) { std::destroy(column + new_size, column + size_); });
+			size_ = new_size;
+		}
+		else
+		{
+			reserve(new_size);
+			while (size_ < new_size)
+				emplace_back(Ts()...);
+		}
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::push_back(value_type const & value) -> reference
+	{
+		// Copy first, in case value refers to elements of this vector that growing would relocate.
+		return push_back(value_type(value));
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::push_back(value_type && value) -> reference
+	{
+		grow_if_full();
+		for_each_in_tuple(columns_, value, [this](auto * column, auto & element)
+		{
+			std::construct_at(column + size_, std::move(element));
+		});
+		++size_;
+		return back();
+	}
+
+	template <typename ... Ts>
+	template <typename ... Args> requires(sizeof...(Args) == sizeof...(Ts))
+	auto soa_vector<Ts...>::emplace_back(Args && ... args) -> reference
+	{
+		// Constructing the whole element before touching the columns means a throwing constructor can't leave
+		// some columns one element longer than the others.
+		return push_back(value_type(std::forward<Args>(args)...));
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::pop_back() noexcept -> void
+	{
+		debug_assert(!empty());
+		--size_;
+		for_each_in_tuple(columns_, [this](auto * column) { std::destroy_at(column + size_); });
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::swap_and_pop(size_t i) noexcept((std::is_nothrow_move_assignable_v<Ts> && ...)) -> void
+	{
+		debug_assert(i < size());
+		size_t const last = size_ - 1;
+		if (i != last)
+			for_each_in_tuple(columns_, [&](auto * column) { column[i] = std::move(column[last]); });
+		pop_back();
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::operator == (soa_vector const & other) const noexcept -> bool requires(std::equality_comparable<Ts> && ...)
+	{
+		if (size_ != other.size_)
+			return false;
+
+		bool equal = true;
+		for_each_in_tuple(columns_, other.columns_, [&](auto * a, auto * b)
+		{
+			equal = equal && std::equal(a, a + size_, b);
+		});
+		return equal;
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::block_size_for(size_t capacity) noexcept -> size_t
+	{
+		size_t size = 0;
+		((size = align(size, alignof(Ts)) + capacity * sizeof(Ts)), ...);
+		return size;
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::allocate_columns(size_t capacity) -> std::tuple<Ts *...>
+	{
+		std::byte * const block = static_cast<std::byte *>(::operator new(block_size_for(capacity), std::align_val_t(block_alignment())));
+
+		// Columns are laid out in order, each one starting at the first address after the previous one that is
+		// aligned for its type. The first column starts at the beginning of the block.
+		std::tuple<Ts *...> columns;
+		size_t offset = 0;
+		for_each_in_tuple(columns, [&](auto * & column)
+		{
+			using T = std::remove_pointer_t<std::remove_reference_t<decltype(column)>>;
+			offset = align(offset, alignof(T));
+			column = reinterpret_cast<T *>(block + offset);
+			offset += capacity * sizeof(T);
+		});
+		return columns;
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::free_columns(std::tuple<Ts *...> columns, size_t capacity) noexcept -> void
+	{
+		if (capacity > 0)
+			::operator delete(std::get<0>(columns), block_size_for(capacity), std::align_val_t(block_alignment()));
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::destroy_elements() noexcept -> void
+	{
+		for_each_in_tuple(columns_, [this](auto * column) { std::destroy_n(column, size_); });
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::relocate_to_capacity(size_t new_capacity) -> void
+	{
+		debug_assert(new_capacity >= size_);
+
+		std::tuple<Ts *...> const new_columns = new_capacity > 0 ? allocate_columns(new_capacity) : std::tuple<Ts *...>();
+		for_each_in_tuple(columns_, new_columns, [this](auto * old_column, auto * new_column)
+		{
+			std::uninitialized_move_n(old_column, size_, new_column);
+			std::destroy_n(old_column, size_);
+		});
+		free_columns(columns_, capacity_);
+		columns_ = new_columns;
+		capacity_ = new_capacity;
+	}
+
+	template <typename ... Ts>
+	auto soa_vector<Ts...>::grow_if_full() -> void
+	{
+		if (size_ == capacity_)
+			relocate_to_capacity(std::max<size_t>(capacity_ * 2, 8));
+	}
+
+} // namespace aeh
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "virtual_memory.hh"
+#include "debug/assert.hh"
+#include <span>
+#include <iterator> // reverse_iterator
+#include <algorithm> // rotate
+#include <memory> // destroy
+#include <ranges>
+
+namespace aeh
+{
+
+	// Vector whose elements never move. It reserves virtual memory for max_size() elements up front and commits pages as
+	// it grows, so growing never relocates the elements and pointers and iterators to them stay valid until they are
+	// erased. Moving the vector doesn't move the elements either. Same interface as fixed_capacity_vector, except that
+	// the maximum size is chosen at runtime and capacity() is the number of elements that fit in committed memory.
+	template <typename T>
+	struct stable_vector
+	{
+		using value_type = T;
+		using iterator = T *;
+		using const_iterator = T const *;
+		using reverse_iterator = std::reverse_iterator<iterator>;
+		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+		using size_type = size_t;
+
+		stable_vector() noexcept = default;
+		explicit stable_vector(size_t max_size, PageSize page_size = PageSize::os_default) noexcept;
+		~stable_vector();
+
+		stable_vector(stable_vector const & other) requires(std::is_copy_constructible_v<T>);
+		stable_vector(stable_vector && other) noexcept;
+		auto operator = (stable_vector const & other) -> stable_vector & requires(std::is_copy_constructible_v<T>);
+		auto operator = (stable_vector && other) noexcept -> stable_vector &;
+
+		[[nodiscard]] auto size() const noexcept -> size_t;
+		[[nodiscard]] auto ssize() const noexcept -> ptrdiff_t;
+		[[nodiscard]] auto int_size() const noexcept -> int;
+		[[nodiscard]] auto empty() const noexcept -> bool;
+		[[nodiscard]] auto capacity() const noexcept -> size_t;
+		[[nodiscard]] auto max_size() const noexcept -> size_t;
+		[[nodiscard]] auto data() noexcept -> T *;
+		[[nodiscard]] auto data() const noexcept -> T const *;
+		[[nodiscard]] auto operator [] (size_t i) noexcept -> T &;
+		[[nodiscard]] auto operator [] (size_t i) const noexcept -> T const &;
+		[[nodiscard]] auto front() noexcept -> T &;
+		[[nodiscard]] auto front() const noexcept -> T const &;
+		[[nodiscard]] auto back() noexcept -> T &;
+		[[nodiscard]] auto back() const noexcept -> T const &;
+
+		[[nodiscard]] auto begin() noexcept -> iterator;
+		[[nodiscard]] auto end() noexcept -> iterator;
+		[[nodiscard]] auto begin() const noexcept -> const_iterator;
+		[[nodiscard]] auto end() const noexcept -> const_iterator;
+		[[nodiscard]] auto cbegin() const noexcept -> const_iterator;
+		[[nodiscard]] auto cend() const noexcept -> const_iterator;
+
+		[[nodiscard]] auto rbegin() noexcept -> reverse_iterator;
+		[[nodiscard]] auto rend() noexcept -> reverse_iterator;
+		[[nodiscard]] auto rbegin() const noexcept -> const_reverse_iterator;
+		[[nodiscard]] auto rend() const noexcept -> const_reverse_iterator;
+		[[nodiscard]] auto crbegin() const noexcept -> const_reverse_iterator;
+		[[nodiscard]] auto crend() const noexcept -> const_reverse_iterator;
+
+		[[nodiscard]] auto nth(size_t i) noexcept -> iterator;
+		[[nodiscard]] auto nth(size_t i) const noexcept -> const_iterator;
+
+		operator std::span<T>() noexcept;
+		operator std::span<T const>() const noexcept;
+
+		auto clear() noexcept -> void;
+		auto push_back(T const & t) noexcept(std::is_nothrow_copy_constructible_v<T>) -> T &;
+		auto push_back(T && t) noexcept(std::is_nothrow_move_constructible_v<T>) -> T &;
+		template <typename ... Args> auto emplace_back(Args && ... args) noexcept(std::is_nothrow_constructible_v<T, Args...>) -> T &;
+		auto pop_back() noexcept -> void;
+		auto resize(size_t new_size) noexcept(std::is_nothrow_default_constructible_v<T>) -> void;
+		auto resize(size_t new_size, T const & value) noexcept(std::is_nothrow_copy_constructible_v<T>) -> void;
+		auto erase(const_iterator pos) noexcept -> iterator;
+		auto erase(const_iterator first, const_iterator last) noexcept -> const_iterator;
+
+		template <std::ranges::input_range R>
+		auto assign(R const & range)
+			noexcept(std::is_nothrow_constructible_v<T, std::ranges::range_value_t<R>>)
+			-> void
+			requires(std::is_constructible_v<T, std::ranges::range_value_t<R>>);
+
+		template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+		auto assign(It first, Sentinel last)
+			noexcept(std::is_nothrow_constructible_v<T, std::iter_value_t<It>>)
+			-> void
+			requires(std::is_constructible_v<T, std::iter_value_t<It>>);
+
+		// Commits memory for at least new_capacity elements.
+		auto reserve(size_t new_capacity) noexcept -> void;
+		// Decommits the pages past the last element. Doesn't move anything, so it is just a system call.
+		auto shrink_to_fit() noexcept -> void;
+
+	private:
+		auto commit_at_least(size_t new_capacity) noexcept -> void;
+
+		VirtualMemoryRegion virtual_memory_region;
+		size_t max_size_ = 0;
+		size_t size_ = 0;
+	};
+
+	template <typename T>
+	[[nodiscard]] auto operator == (stable_vector<T> const & a, stable_vector<T> const & b) noexcept -> bool;
+
+	template <typename T>
+	[[nodiscard]] auto operator <=> (stable_vector<T> const & a, stable_vector<T> const & b) noexcept;
+
+} // namespace aeh
+
+#include "stable_vector.inl"
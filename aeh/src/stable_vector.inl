@@ -0,0 +1,403 @@
+#include <limits>
+#include <utility>
+
+namespace aeh
+{
+
+	template <typename T>
+	stable_vector<T>::stable_vector(size_t max_size, PageSize page_size) noexcept
+		: virtual_memory_region(VirtualMemoryRegion::reserve_bytes_of_virtual_memory(max_size * sizeof(T), page_size))
+		, max_size_(max_size)
+	{
+		debug_assert_msg(max_size == 0 || virtual_memory_region.memory_region_address() != nullptr, "Could not reserve virtual memory for stable_vector");
+		debug_assert(alignof(T) <= virtual_memory_region.page_size());
+	}
+
+	template <typename T>
+	stable_vector<T>::~stable_vector()
+	{
+		clear();
+	}
+
+	template <typename T>
+	stable_vector<T>::stable_vector(stable_vector const & other) requires(std::is_copy_constructible_v<T>)
+		: stable_vector(other.max_size())
+	{
+		reserve(other.size());
+		std::uninitialized_copy_n(other.data(), other.size(), data());
+		size_ = other.size();
+	}
+
+	template <typename T>
+	stable_vector<T>::stable_vector(stable_vector && other) noexcept
+		: virtual_memory_region(std::move(other.virtual_memory_region))
+		, max_size_(std::exchange(other.max_size_, 0))
+		, size_(std::exchange(other.size_, 0))
+	{}
+
+	template <typename T>
+	auto stable_vector<T>::operator = (stable_vector const & other) -> stable_vector & requires(std::is_copy_constructible_v<T>)
+	{
+		if (max_size() < other.size())
+			return *this = stable_vector(other);
+
+		clear();
+		reserve(other.size());
+		std::uninitialized_copy_n(other.data(), other.size(), data());
+		size_ = other.size();
+		return *this;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::operator = (stable_vector && other) noexcept -> stable_vector &
+	{
+		clear();
+		virtual_memory_region = std::move(other.virtual_memory_region);
+		max_size_ = std::exchange(other.max_size_, 0);
+		size_ = std::exchange(other.size_, 0);
+		return *this;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::size() const noexcept -> size_t
+	{
+		return size_;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::ssize() const noexcept -> ptrdiff_t
+	{
+		return ptrdiff_t(size());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::int_size() const noexcept -> int
+	{
+		debug_assert(size() <= size_t(std::numeric_limits<int>::max()));
+		return int(size());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::empty() const noexcept -> bool
+	{
+		return size() == 0;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::capacity() const noexcept -> size_t
+	{
+		return std::min(virtual_memory_region.physical_memory_size_in_bytes() / sizeof(T), max_size());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::max_size() const noexcept -> size_t
+	{
+		return max_size_;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::data() noexcept -> T *
+	{
+		return static_cast<T *>(virtual_memory_region.memory_region_address());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::data() const noexcept -> T const *
+	{
+		return static_cast<T const *>(virtual_memory_region.memory_region_address());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::operator [] (size_t i) noexcept -> T &
+	{
+		debug_assert(i < size());
+		return data()[i];
+	}
+
+	template <typename T>
+	auto stable_vector<T>::operator [] (size_t i) const noexcept -> T const &
+	{
+		debug_assert(i < size());
+		return data()[i];
+	}
+
+	template <typename T>
+	auto stable_vector<T>::front() noexcept -> T &
+	{
+		return (*this)[0];
+	}
+
+	template <typename T>
+	auto stable_vector<T>::front() const noexcept -> T const &
+	{
+		return (*this)[0];
+	}
+
+	template <typename T>
+	auto stable_vector<T>::back() noexcept -> T &
+	{
+		return (*this)[size() - 1];
+	}
+
+	template <typename T>
+	auto stable_vector<T>::back() const noexcept -> T const &
+	{
+		return (*this)[size() - 1];
+	}
+
+	template <typename T>
+	auto stable_vector<T>::begin() noexcept -> iterator
+	{
+		return data();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::end() noexcept -> iterator
+	{
+		return data() + size();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::begin() const noexcept -> const_iterator
+	{
+		return cbegin();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::end() const noexcept -> const_iterator
+	{
+		return cend();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::cbegin() const noexcept -> const_iterator
+	{
+		return data();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::cend() const noexcept -> const_iterator
+	{
+		return data() + size();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::rbegin() noexcept -> reverse_iterator
+	{
+		return reverse_iterator(end());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::rend() noexcept -> reverse_iterator
+	{
+		return reverse_iterator(begin());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::rbegin() const noexcept -> const_reverse_iterator
+	{
+		return crbegin();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::rend() const noexcept -> const_reverse_iterator
+	{
+		return crend();
+	}
+
+	template <typename T>
+	auto stable_vector<T>::crbegin() const noexcept -> const_reverse_iterator
+	{
+		return const_reverse_iterator(cend());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::crend() const noexcept -> const_reverse_iterator
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::nth(size_t i) noexcept -> iterator
+	{
+		debug_assert(i <= size());
+		return begin() + i;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::nth(size_t i) const noexcept -> const_iterator
+	{
+		debug_assert(i <= size());
+		return begin() + i;
+	}
+
+	template <typename T>
+	stable_vector<T>::operator std::span<T>() noexcept
+	{
+		return std::span<T>(data(), size());
+	}
+
+	template <typename T>
+	stable_vector<T>::operator std::span<T const>() const noexcept
+	{
+		return std::span<T const>(data(), size());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::clear() noexcept -> void
+	{
+		std::destroy(begin(), end());
+		size_ = 0;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::push_back(T const & t) noexcept(std::is_nothrow_copy_constructible_v<T>) -> T &
+	{
+		return emplace_back(t);
+	}
+
+	template <typename T>
+	auto stable_vector<T>::push_back(T && t) noexcept(std::is_nothrow_move_constructible_v<T>) -> T &
+	{
+		return emplace_back(std::move(t));
+	}
+
+	template <typename T>
+	template <typename ... Args>
+	auto stable_vector<T>::emplace_back(Args && ... args) noexcept(std::is_nothrow_constructible_v<T, Args...>) -> T &
+	{
+		// Elements never move, so args may refer to an element of this vector.
+		commit_at_least(size() + 1);
+		T * const new_element = std::construct_at(data() + size(), std::forward<Args>(args)...);
+		size_++;
+		return *new_element;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::pop_back() noexcept -> void
+	{
+		std::destroy_at(&back());
+		size_--;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::resize(size_t new_size) noexcept(std::is_nothrow_default_constructible_v<T>) -> void
+	{
+		if (new_size < size())
+			std::destroy(begin() + new_size, end());
+		else
+		{
+			commit_at_least(new_size);
+			std::uninitialized_default_construct(begin() + size(), begin() + new_size);
+		}
+
+		size_ = new_size;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::resize(size_t new_size, T const & value) noexcept(std::is_nothrow_copy_constructible_v<T>) -> void
+	{
+		if (new_size < size())
+			std::destroy(begin() + new_size, end());
+		else
+		{
+			commit_at_least(new_size);
+			std::uninitialized_fill(begin() + size(), begin() + new_size, value);
+		}
+
+		size_ = new_size;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::erase(const_iterator pos) noexcept -> iterator
+	{
+		debug_assert(pos >= begin() && pos < end());
+		iterator const pos_mutable = nth(pos - begin());
+		std::rotate(pos_mutable, pos_mutable + 1, end());
+		std::destroy_at(&back());
+		size_--;
+		return pos_mutable;
+	}
+
+	template <typename T>
+	auto stable_vector<T>::erase(const_iterator first, const_iterator last) noexcept -> const_iterator
+	{
+		ptrdiff_t const n = std::distance(first, last);
+		if (n <= 0)
+			return nth(first - begin());
+
+		debug_assert(first >= begin() && first < end());
+		debug_assert(last > begin() && last <= end());
+		iterator const first_mutable = nth(first - begin());
+		iterator const first_to_destroy = std::rotate(first_mutable, first_mutable + n, end());
+		std::destroy_n(first_to_destroy, n);
+		size_ -= n;
+		return first_mutable;
+	}
+
+	template <typename T>
+	template <std::ranges::input_range R>
+	auto stable_vector<T>::assign(R const & range)
+		noexcept(std::is_nothrow_constructible_v<T, std::ranges::range_value_t<R>>)
+		-> void
+		requires(std::is_constructible_v<T, std::ranges::range_value_t<R>>)
+	{
+		assign(range.begin(), range.end());
+	}
+
+	template <typename T>
+	template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+	auto stable_vector<T>::assign(It first, Sentinel last)
+		noexcept(std::is_nothrow_constructible_v<T, std::iter_value_t<It>>)
+		-> void
+		requires(std::is_constructible_v<T, std::iter_value_t<It>>)
+	{
+		clear();
+		for (It it = first; it != last; ++it)
+			emplace_back(*it);
+	}
+
+	template <typename T>
+	auto stable_vector<T>::reserve(size_t new_capacity) noexcept -> void
+	{
+		debug_assert(new_capacity <= max_size());
+		if (new_capacity <= capacity())
+			return;
+
+		size_t const bytes_to_commit = virtual_memory_region.align_to_page_boundary(new_capacity * sizeof(T));
+		[[maybe_unused]] bool const committed = virtual_memory_region.allocate_extra_pages_of_physical_memory(
+			(bytes_to_commit - virtual_memory_region.physical_memory_size_in_bytes()) / virtual_memory_region.page_size());
+		debug_assert_msg(committed, "Could not commit memory for stable_vector");
+	}
+
+	template <typename T>
+	auto stable_vector<T>::shrink_to_fit() noexcept -> void
+	{
+		size_t const bytes_to_keep = virtual_memory_region.align_to_page_boundary(size() * sizeof(T));
+		virtual_memory_region.free_all_pages_of_physical_memory_up_to(bytes_to_keep / virtual_memory_region.page_size());
+	}
+
+	template <typename T>
+	auto stable_vector<T>::commit_at_least(size_t new_capacity) noexcept -> void
+	{
+		debug_assert_msg(new_capacity <= max_size(), "stable_vector grew past the size it reserved");
+		if (new_capacity <= capacity())
+			return;
+
+		// Double the committed memory, like std::vector does, to keep the number of system calls logarithmic.
+		reserve(std::min(std::max(new_capacity, 2 * capacity()), max_size()));
+	}
+
+	template <typename T>
+	auto operator == (stable_vector<T> const & a, stable_vector<T> const & b) noexcept -> bool
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end());
+	}
+
+	template <typename T>
+	auto operator <=> (stable_vector<T> const & a, stable_vector<T> const & b) noexcept
+	{
+		return std::lexicographical_compare_three_way(a.begin(), a.end(), b.begin(), b.end());
+	}
+
+} // namespace aeh
@@ -0,0 +1,71 @@
+#include "thread_local_arena_pool.hh"
+#include "debug/assert.hh"
+#include "internal/thread_local_cache.hh"
+
+namespace aeh
+{
+
+	namespace
+	{
+		std::atomic<uint64_t> next_pool_id = 1;
+
+		// Arenas of the last few pools the thread used, so that alternating between pools doesn't take the lock.
+		thread_local detail::ThreadLocalCache<MemoryArena, 8> local_arena_cache;
+	} // namespace
+
+	ThreadLocalArenaPool::ThreadLocalArenaPool(size_t max_thread_count, size_t virtual_region_size_per_thread_in_bytes) noexcept
+		: pages_per_slot(align_to_os_memory_page_boundary(virtual_region_size_per_thread_in_bytes) / os_memory_page_size)
+		, slot_count(max_thread_count)
+		, slots(std::make_unique<Slot[]>(max_thread_count))
+		, id(next_pool_id.fetch_add(1, std::memory_order_relaxed))
+	{
+		virtual_memory_region = VirtualMemoryRegion::reserve_pages_of_virtual_memory(pages_per_slot * slot_count);
+	}
+
+	auto ThreadLocalArenaPool::local_arena() noexcept -> MemoryArena &
+	{
+		if (auto const * const entry = local_arena_cache.find(id))
+			return *entry->value;
+
+		MemoryArena & arena = assign_slot_to_this_thread();
+		local_arena_cache.insert(id, &arena);
+		return arena;
+	}
+
+	auto ThreadLocalArenaPool::assign_slot_to_this_thread() noexcept -> MemoryArena &
+	{
+		auto const lock = std::lock_guard(slot_assignment_mutex);
+
+		// The thread may already have a slot if its cache entry was evicted.
+		std::thread::id const this_thread = std::this_thread::get_id();
+		size_t const used = used_slot_count.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < used; ++i)
+			if (slots[i].owner == this_thread)
+				return slots[i].arena;
+
+		debug_assert_msg(used < slot_count, "More threads asked for an arena than the pool was created for");
+
+		Slot & slot = slots[used];
+		slot.owner = this_thread;
+		slot.arena = MemoryArena::in_virtual_region(virtual_memory_region.subregion(used * pages_per_slot, pages_per_slot));
+		used_slot_count.store(used + 1, std::memory_order_release);
+		return slot.arena;
+	}
+
+	auto ThreadLocalArenaPool::reset_all() noexcept -> void
+	{
+		size_t const used = used_slot_count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < used; ++i)
+			slots[i].arena.free_all();
+	}
+
+	auto ThreadLocalArenaPool::allocated_bytes() const noexcept -> size_t
+	{
+		size_t total = 0;
+		size_t const used = used_slot_count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < used; ++i)
+			total += slots[i].arena.allocated_bytes();
+		return total;
+	}
+
+} // namespace aeh
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "memory_arena.hh"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace aeh
+{
+
+	// Gives each thread that asks for one its own MemoryArena, so that scratch memory can be allocated without any
+	// synchronization. All arenas are carved out of a single reservation of virtual memory, made when the pool is
+	// created, and a thread's arena is created the first time that thread calls local_arena().
+	//
+	// reset_all() and allocated_bytes() look at the arenas of every thread, so they must only be called at points where
+	// no thread is allocating, such as frame or epoch boundaries after the threads have synchronized with the caller.
+	struct ThreadLocalArenaPool
+	{
+		explicit ThreadLocalArenaPool(size_t max_thread_count, size_t virtual_region_size_per_thread_in_bytes) noexcept;
+		ThreadLocalArenaPool(ThreadLocalArenaPool const &) = delete;
+		ThreadLocalArenaPool(ThreadLocalArenaPool &&) = delete;
+		auto operator = (ThreadLocalArenaPool const &) -> ThreadLocalArenaPool & = delete;
+		auto operator = (ThreadLocalArenaPool &&) -> ThreadLocalArenaPool & = delete;
+
+		// Arena of the calling thread. Each thread remembers the arenas of the last 8 pools it used, and only takes a lock
+		// on the first call or when it comes back to a pool after using more than 8 others.
+		// No more than max_thread_count different threads may call this.
+		[[nodiscard]] auto local_arena() noexcept -> MemoryArena &;
+
+		auto reset_all() noexcept -> void;
+		[[nodiscard]] auto allocated_bytes() const noexcept -> size_t;
+
+		[[nodiscard]] auto max_thread_count() const noexcept -> size_t { return slot_count; }
+		[[nodiscard]] auto thread_count() const noexcept -> size_t { return used_slot_count.load(std::memory_order_acquire); }
+
+	private:
+		auto assign_slot_to_this_thread() noexcept -> MemoryArena &;
+
+		struct alignas(cache_line_size) Slot
+		{
+			MemoryArena arena;
+			std::thread::id owner;
+		};
+
+		// Declared before the slots so that arenas give back their pages before the reservation is released.
+		VirtualMemoryRegion virtual_memory_region;
+		size_t pages_per_slot;
+		size_t slot_count;
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<size_t> used_slot_count = 0;
+		std::mutex slot_assignment_mutex;
+		// Tells pools apart in the per-thread cache, even if a pool is created where a destroyed one used to be.
+		uint64_t id;
+	};
+
+} // namespace aeh
@@ -0,0 +1,103 @@
+#include "thread_pool.hh"
+#include "debug/assert.hh"
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		auto ThreadPoolJob::try_run() noexcept -> bool
+		{
+			State expected = State::queued;
+			if (!state.compare_exchange_strong(expected, State::running, std::memory_order_acquire))
+				return false;
+
+			try
+			{
+				run();
+			}
+			catch (...)
+			{
+				thrown_exception = std::current_exception();
+			}
+
+			state.store(State::done, std::memory_order_release);
+			state.notify_all();
+			return true;
+		}
+
+		auto ThreadPoolJob::wait_until_done() const noexcept -> void
+		{
+			for (State current = state.load(std::memory_order_acquire); current != State::done; current = state.load(std::memory_order_acquire))
+				state.wait(current, std::memory_order_acquire);
+		}
+	} // namespace detail
+
+	ThreadPool::Task::~Task()
+	{
+		// Same as std::thread, a task must be joined before its handle goes away.
+		debug_assert_msg(!joinable(), "ThreadPool::Task destroyed without being joined");
+	}
+
+	auto ThreadPool::Task::join() -> void
+	{
+		debug_assert(joinable());
+
+		if (!job->try_run())
+			job->wait_until_done();
+
+		std::exception_ptr const exception = job->exception();
+		job = nullptr;
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+
+	ThreadPool::ThreadPool(size_t thread_count)
+	{
+		workers.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; ++i)
+			workers.emplace_back(&ThreadPool::worker_loop, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			auto const lock = std::lock_guard(queue_mutex);
+			stopping = true;
+		}
+		queue_not_empty.notify_all();
+
+		for (std::thread & worker : workers)
+			worker.join();
+	}
+
+	auto ThreadPool::push(std::shared_ptr<detail::ThreadPoolJob> job) -> void
+	{
+		{
+			auto const lock = std::lock_guard(queue_mutex);
+			queue.push_back(std::move(job));
+		}
+		queue_not_empty.notify_one();
+	}
+
+	auto ThreadPool::worker_loop() noexcept -> void
+	{
+		for (;;)
+		{
+			std::shared_ptr<detail::ThreadPoolJob> job;
+			{
+				auto lock = std::unique_lock(queue_mutex);
+				queue_not_empty.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (queue.empty())
+					return; // Stopping and nothing left to do.
+
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			// May fail if whoever holds the handle already joined it and ran the job inline.
+			job->try_run();
+		}
+	}
+
+} // namespace aeh
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aeh
+{
+
+	namespace detail
+	{
+		struct ThreadPoolJob
+		{
+			virtual ~ThreadPoolJob() = default;
+
+			// Runs the job if nobody has started it yet. Returns false if another thread got to it first.
+			auto try_run() noexcept -> bool;
+			auto wait_until_done() const noexcept -> void;
+			[[nodiscard]] auto exception() const noexcept -> std::exception_ptr const & { return thrown_exception; }
+
+		private:
+			virtual auto run() -> void = 0;
+
+			enum struct State : int { queued, running, done };
+			std::atomic<State> state = State::queued;
+			std::exception_ptr thrown_exception;
+		};
+
+		template <typename F>
+		struct ThreadPoolJobImpl final : ThreadPoolJob
+		{
+			explicit ThreadPoolJobImpl(F f) : function(std::move(f)) {}
+
+		private:
+			auto run() -> void override { function(); }
+
+			F function;
+		};
+	} // namespace detail
+
+	// Fixed set of worker threads that sleep while there is no work, so that short jobs don't pay
+	// for thread creation. A ThreadPool & can be passed wherever an executor like run_in_new_thread
+	// is expected: calling it queues the callable and returns a joinable handle.
+	struct ThreadPool
+	{
+		// Handle to a job submitted to the pool. Mirrors the part of std::thread's interface that executors need.
+		struct Task
+		{
+			Task() noexcept = default;
+			Task(Task const &) = delete;
+			Task(Task &&) noexcept = default;
+			auto operator = (Task const &) -> Task & = delete;
+			auto operator = (Task &&) noexcept -> Task & = default;
+			~Task();
+
+			[[nodiscard]] auto joinable() const noexcept -> bool { return job != nullptr; }
+
+			// Waits for the job to finish. If no worker has picked it up yet, it is run on the calling thread
+			// instead, so joining never depends on a worker being free. Rethrows any exception thrown by the job.
+			auto join() -> void;
+
+		private:
+			explicit Task(std::shared_ptr<detail::ThreadPoolJob> job_) noexcept : job(std::move(job_)) {}
+
+			std::shared_ptr<detail::ThreadPoolJob> job;
+
+			friend struct ThreadPool;
+		};
+
+		explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+		ThreadPool(ThreadPool const &) = delete;
+		ThreadPool(ThreadPool &&) = delete;
+		auto operator = (ThreadPool const &) -> ThreadPool & = delete;
+		auto operator = (ThreadPool &&) -> ThreadPool & = delete;
+
+		// Finishes all queued jobs before joining the workers.
+		~ThreadPool();
+
+		[[nodiscard]] auto thread_count() const noexcept -> size_t { return workers.size(); }
+
+		// Same contract as the std::thread constructor: arguments are decay-copied and invoked on a worker thread.
+		template <typename F, typename ... Args>
+		[[nodiscard]] auto operator () (F && f, Args && ... args) -> Task;
+
+		// Fire and forget. Like operator () but without a handle to join, for jobs that signal their own completion.
+		// The job must not throw: an exception escaping it calls std::terminate, as it would on a std::thread.
+		template <typename F>
+		auto post(F && f) -> void;
+
+	private:
+		auto push(std::shared_ptr<detail::ThreadPoolJob> job) -> void;
+		auto worker_loop() noexcept -> void;
+
+		std::mutex queue_mutex;
+		std::condition_variable queue_not_empty;
+		std::deque<std::shared_ptr<detail::ThreadPoolJob>> queue;
+		bool stopping = false;
+		std::vector<std::thread> workers;
+	};
+
+} // namespace aeh
+
+#include "thread_pool.inl"
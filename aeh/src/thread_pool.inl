@@ -0,0 +1,29 @@
+#include <functional>
+
+namespace aeh
+{
+
+	template <typename F, typename ... Args>
+	auto ThreadPool::operator () (F && f, Args && ... args) -> Task
+	{
+		auto bound = [function = std::decay_t<F>(std::forward<F>(f)), ...arguments = std::decay_t<Args>(std::forward<Args>(args))]() mutable
+		{
+			std::invoke(std::move(function), std::move(arguments)...);
+		};
+
+		auto job = std::make_shared<detail::ThreadPoolJobImpl<decltype(bound)>>(std::move(bound));
+		push(job);
+		return Task(std::move(job));
+	}
+
+	template <typename F>
+	auto ThreadPool::post(F && f) -> void
+	{
+		auto job = [function = std::decay_t<F>(std::forward<F>(f))]() mutable noexcept
+		{
+			std::invoke(function);
+		};
+		push(std::make_shared<detail::ThreadPoolJobImpl<decltype(job)>>(std::move(job)));
+	}
+
+} // namespace aeh
@@ -9,6 +9,9 @@
 	#include <unistd.h>
 	#include <sys/mman.h>
 #endif
+#include <bit>
+#include <cstdio>
+#include <utility> // exchange
 
 namespace aeh
 {
@@ -22,10 +25,38 @@ namespace aeh
 		return static_cast<size_t>(system_info.dwPageSize);
 	}();
 
+	// Large pages on Windows have to be committed when they are reserved, so regions never use them.
+	size_t const huge_memory_page_size = 0;
+
+	// Views of a file mapping can only be placed at multiples of the allocation granularity, which is usually 64 KiB.
+	size_t const mirrored_memory_granularity = []
+	{
+		SYSTEM_INFO system_info;
+		GetSystemInfo(&system_info);
+		return static_cast<size_t>(system_info.dwAllocationGranularity);
+	}();
+
 #elif AEH_LINUX
 
 	size_t const os_memory_page_size = static_cast<size_t>(getpagesize());
 
+	// Size of a page table entry at the level above base pages, which is what transparent huge pages use. 2 MiB on
+	// x86-64 and on ARM64 with 4 KiB pages, but not on every system, so ask the kernel when it says.
+	size_t const huge_memory_page_size = []
+	{
+		size_t size = 2 * 1024 * 1024;
+		if (std::FILE * const file = std::fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r"))
+		{
+			unsigned long long value = 0;
+			if (std::fscanf(file, "%llu", &value) == 1 && std::has_single_bit(value))
+				size = static_cast<size_t>(value);
+			std::fclose(file);
+		}
+		return size;
+	}();
+
+	size_t const mirrored_memory_granularity = os_memory_page_size;
+
 #endif
 
 	auto align_to_os_memory_page_boundary(size_t n) noexcept -> size_t
@@ -37,10 +68,13 @@ namespace aeh
 		: memory(other.memory)
 		, physical_memory_backed_size(other.physical_memory_backed_size)
 		, virtual_region_size(other.virtual_region_size)
+		, memory_page_size(other.memory_page_size)
+		, owns_reservation(other.owns_reservation)
 	{
 		other.memory = nullptr;
 		other.physical_memory_backed_size = 0;
 		other.virtual_region_size = 0;
+		other.owns_reservation = true;
 	}
 
 	auto VirtualMemoryRegion::operator = (VirtualMemoryRegion && other) noexcept -> VirtualMemoryRegion &
@@ -50,10 +84,13 @@ namespace aeh
 		memory = other.memory;
 		physical_memory_backed_size = other.physical_memory_backed_size;
 		virtual_region_size = other.virtual_region_size;
+		memory_page_size = other.memory_page_size;
+		owns_reservation = other.owns_reservation;
 
 		other.memory = nullptr;
 		other.physical_memory_backed_size = 0;
 		other.virtual_region_size = 0;
+		other.owns_reservation = true;
 
 		return *this;
 	}
@@ -63,37 +100,138 @@ namespace aeh
 		free_virtual_memory_region();
 	}
 
-	auto VirtualMemoryRegion::reserve_bytes_of_virtual_memory(size_t number_of_bytes) noexcept -> VirtualMemoryRegion
+#if AEH_LINUX
+	namespace
+	{
+		// Reserves memory for huge pages and returns its address, or nullptr if the system can't back it with huge pages.
+		auto reserve_huge_pages(size_t number_of_bytes) noexcept -> void *
+		{
+			// Explicit huge pages come from a pool reserved by the administrator. Without MAP_NORESERVE, mmap fails right
+			// away if the pool can't back the whole region, instead of raising SIGBUS when a page is first touched.
+			// The size of the pages is passed explicitly because plain MAP_HUGETLB uses the default size of the pool, which
+			// may be 1 GiB, and the region commits and decommits in steps of huge_memory_page_size.
+			int const huge_page_size_flag = std::countr_zero(huge_memory_page_size) << MAP_HUGE_SHIFT;
+			void * const explicit_huge_pages = mmap(nullptr, number_of_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge_page_size_flag, -1, 0);
+			if (explicit_huge_pages != MAP_FAILED)
+				return explicit_huge_pages;
+
+			// Transparent huge pages need the region to be aligned to the huge page size. Reserve enough to find an
+			// aligned address inside and give back what's around it.
+			size_t const padded_size = number_of_bytes + huge_memory_page_size - os_memory_page_size;
+			void * const padded = mmap(nullptr, padded_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (padded == MAP_FAILED)
+				return nullptr;
+
+			char * const padded_begin = static_cast<char *>(padded);
+			char * const aligned_begin = align(padded_begin, huge_memory_page_size);
+			char * const aligned_end = aligned_begin + number_of_bytes;
+			if (aligned_begin != padded_begin)
+				munmap(padded_begin, static_cast<size_t>(aligned_begin - padded_begin));
+			if (aligned_end != padded_begin + padded_size)
+				munmap(aligned_end, static_cast<size_t>(padded_begin + padded_size - aligned_end));
+
+			// Fails if the kernel was built without transparent huge pages or they are disabled.
+			if (madvise(aligned_begin, number_of_bytes, MADV_HUGEPAGE) != 0)
+			{
+				munmap(aligned_begin, number_of_bytes);
+				return nullptr;
+			}
+			return aligned_begin;
+		}
+	} // namespace
+#endif
+
+	auto VirtualMemoryRegion::reserve_bytes_of_virtual_memory(size_t number_of_bytes, PageSize page_size) noexcept -> VirtualMemoryRegion
 	{
 		if (number_of_bytes == 0)
 			return VirtualMemoryRegion();
 
-		number_of_bytes = align_to_os_memory_page_boundary(number_of_bytes);
-
 		VirtualMemoryRegion virtual_memory_region;
 
+		#if AEH_LINUX
+			if (page_size == PageSize::huge)
+			{
+				size_t const huge_number_of_bytes = align(number_of_bytes, huge_memory_page_size);
+				virtual_memory_region.memory = reserve_huge_pages(huge_number_of_bytes);
+				if (virtual_memory_region.memory != nullptr)
+				{
+					virtual_memory_region.virtual_region_size = huge_number_of_bytes;
+					virtual_memory_region.memory_page_size = huge_memory_page_size;
+					return virtual_memory_region;
+				}
+			}
+		#else
+			static_cast<void>(page_size);
+		#endif
+
+		number_of_bytes = align_to_os_memory_page_boundary(number_of_bytes);
+
 		#if AEH_WINDOWS
 			virtual_memory_region.memory = VirtualAlloc(nullptr, number_of_bytes, MEM_RESERVE, PAGE_READWRITE);
 		#elif AEH_LINUX
-			virtual_memory_region.memory = mmap(nullptr, number_of_bytes, PROT_NONE, MAP_ANONYMOUS, -1, 0);
+			virtual_memory_region.memory = mmap(nullptr, number_of_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (virtual_memory_region.memory == MAP_FAILED)
+				virtual_memory_region.memory = nullptr;
 		#endif
-		
+
+		if (virtual_memory_region.memory == nullptr)
+			return VirtualMemoryRegion();
+
 		virtual_memory_region.virtual_region_size = number_of_bytes;
 
 		return virtual_memory_region;
 	}
 
-	auto VirtualMemoryRegion::reserve_pages_of_virtual_memory(size_t number_of_pages) noexcept -> VirtualMemoryRegion
+	auto VirtualMemoryRegion::reserve_pages_of_virtual_memory(size_t number_of_pages, PageSize page_size) noexcept -> VirtualMemoryRegion
 	{
-		return reserve_bytes_of_virtual_memory(number_of_pages * os_memory_page_size);
+		size_t const bytes_per_page = page_size == PageSize::huge && huge_memory_page_size > 0 ? huge_memory_page_size : os_memory_page_size;
+		return reserve_bytes_of_virtual_memory(number_of_pages * bytes_per_page, page_size);
+	}
+
+	auto VirtualMemoryRegion::align_to_page_boundary(size_t n) const noexcept -> size_t
+	{
+		return align(n, memory_page_size);
+	}
+
+	auto VirtualMemoryRegion::subregion(size_t first_page, size_t number_of_pages) const noexcept -> VirtualMemoryRegion
+	{
+		debug_assert(memory != nullptr);
+		debug_assert((first_page + number_of_pages) * memory_page_size <= virtual_region_size);
+
+		VirtualMemoryRegion view;
+		view.memory = static_cast<char *>(memory) + first_page * memory_page_size;
+		view.virtual_region_size = number_of_pages * memory_page_size;
+		view.memory_page_size = memory_page_size;
+		view.owns_reservation = false;
+		return view;
 	}
 
-	auto VirtualMemoryRegion::allocate_extra_pages_of_physical_memory(size_t number_of_pages) noexcept -> bool
+	namespace
+	{
+		auto prefault_pages(char * begin, size_t number_of_bytes) noexcept -> void
+		{
+			#if AEH_LINUX && defined(MADV_POPULATE_WRITE)
+				// Fails with EINVAL on kernels older than 5.14.
+				if (madvise(begin, number_of_bytes, MADV_POPULATE_WRITE) == 0)
+					return;
+			#endif
+
+			// Committed memory that is not in use may have been used before, so write back what is there instead of 0.
+			for (size_t i = 0; i < number_of_bytes; i += os_memory_page_size)
+			{
+				volatile char & byte = begin[i];
+				char const value = byte;
+				byte = value;
+			}
+		}
+	} // namespace
+
+	auto VirtualMemoryRegion::allocate_extra_pages_of_physical_memory(size_t number_of_pages, Prefault prefault) noexcept -> bool
 	{
 		// Must have a region of virtual memory in order to be able to allocate physical memory.
 		debug_assert(memory != nullptr);
 
-		size_t const new_size_in_bytes = physical_memory_backed_size + number_of_pages * os_memory_page_size;
+		size_t const new_size_in_bytes = physical_memory_backed_size + number_of_pages * memory_page_size;
 		debug_assert(new_size_in_bytes <= virtual_region_size);
 
 		#if AEH_WINDOWS
@@ -105,6 +243,10 @@ namespace aeh
 			if (result != 0)
 				return false;
 		#endif
+
+		if (prefault == Prefault::yes)
+			prefault_pages(static_cast<char *>(memory) + physical_memory_backed_size, new_size_in_bytes - physical_memory_backed_size);
+
 		physical_memory_backed_size = new_size_in_bytes;
 
 		return true;
@@ -126,7 +268,7 @@ namespace aeh
 
 		if (number_of_pages_to_keep < physical_memory_size_in_pages())
 		{
-			size_t const bytes_to_keep = number_of_pages_to_keep * os_memory_page_size;
+			size_t const bytes_to_keep = number_of_pages_to_keep * memory_page_size;
 			size_t const bytes_to_free = physical_memory_backed_size - bytes_to_keep;
 
 			#if AEH_WINDOWS
@@ -134,6 +276,8 @@ namespace aeh
 				if (!free_ok)
 					return false;
 			#elif AEH_LINUX
+				// Protecting the pages alone would keep their physical memory.
+				madvise(static_cast<char *>(memory) + bytes_to_keep, bytes_to_free, MADV_DONTNEED);
 				int const result = mprotect(static_cast<char *>(memory) + bytes_to_keep, bytes_to_free, PROT_NONE);
 				if (result != 0)
 					return false;
@@ -145,9 +289,42 @@ namespace aeh
 		return true;
 	}
 
+	auto VirtualMemoryRegion::discard_pages_of_physical_memory(size_t first_page, size_t number_of_pages) noexcept -> bool
+	{
+		debug_assert(memory != nullptr);
+		debug_assert((first_page + number_of_pages) * memory_page_size <= physical_memory_backed_size);
+
+		if (number_of_pages == 0)
+			return true;
+
+		char * const begin = static_cast<char *>(memory) + first_page * memory_page_size;
+		size_t const number_of_bytes = number_of_pages * memory_page_size;
+
+		#if AEH_WINDOWS
+			return VirtualAlloc(begin, number_of_bytes, MEM_RESET, PAGE_READWRITE) != nullptr;
+		#elif AEH_LINUX
+			// MADV_FREE only exists since Linux 4.5, and doesn't work on explicit huge pages.
+			#ifdef MADV_FREE
+				if (madvise(begin, number_of_bytes, MADV_FREE) == 0)
+					return true;
+			#endif
+			return madvise(begin, number_of_bytes, MADV_DONTNEED) == 0;
+		#endif
+	}
+
 	auto VirtualMemoryRegion::free_virtual_memory_region() noexcept -> bool
 	{
-		if (memory != nullptr)
+		if (memory != nullptr && !owns_reservation)
+		{
+			// Views only give back their physical memory. The reservation belongs to the region they were made from.
+			if (!free_all_pages_of_physical_memory_up_to(0))
+				return false;
+
+			memory = nullptr;
+			virtual_region_size = 0;
+			owns_reservation = true;
+		}
+		else if (memory != nullptr)
 		{
 			#if AEH_WINDOWS
 				BOOL const free_ok = VirtualFree(memory, 0, MEM_RELEASE);
@@ -167,4 +344,123 @@ namespace aeh
 		return true;
 	}
 
+	MirroredMemoryRegion::MirroredMemoryRegion(MirroredMemoryRegion && other) noexcept
+		: memory(std::exchange(other.memory, nullptr))
+		, mirrored_size(std::exchange(other.mirrored_size, 0))
+	{}
+
+	auto MirroredMemoryRegion::operator = (MirroredMemoryRegion && other) noexcept -> MirroredMemoryRegion &
+	{
+		free_mirrored_memory_region();
+		memory = std::exchange(other.memory, nullptr);
+		mirrored_size = std::exchange(other.mirrored_size, 0);
+		return *this;
+	}
+
+	MirroredMemoryRegion::~MirroredMemoryRegion()
+	{
+		free_mirrored_memory_region();
+	}
+
+	auto MirroredMemoryRegion::map_bytes_of_mirrored_memory(size_t number_of_bytes) noexcept -> MirroredMemoryRegion
+	{
+		if (number_of_bytes == 0)
+			return MirroredMemoryRegion();
+
+		number_of_bytes = align(number_of_bytes, mirrored_memory_granularity);
+		MirroredMemoryRegion region;
+
+		#if AEH_WINDOWS
+			// Reserve a placeholder for both copies, split it in two and replace each half with a view of the same
+			// pagefile-backed section. Placeholders keep other threads from taking the address range in between.
+			HANDLE const section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+				static_cast<DWORD>(static_cast<unsigned long long>(number_of_bytes) >> 32), static_cast<DWORD>(number_of_bytes), nullptr);
+			if (section == nullptr)
+				return region;
+
+			char * const placeholder = static_cast<char *>(VirtualAlloc2(nullptr, nullptr, 2 * number_of_bytes,
+				MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, nullptr, 0));
+			if (placeholder == nullptr)
+			{
+				CloseHandle(section);
+				return region;
+			}
+			VirtualFree(placeholder, number_of_bytes, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER);
+
+			void * const first_view = MapViewOfFile3(section, nullptr, placeholder, 0, number_of_bytes,
+				MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, nullptr, 0);
+			void * const second_view = MapViewOfFile3(section, nullptr, placeholder + number_of_bytes, 0, number_of_bytes,
+				MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, nullptr, 0);
+			// The views keep the section alive.
+			CloseHandle(section);
+
+			if (first_view == nullptr || second_view == nullptr)
+			{
+				if (first_view != nullptr)
+					UnmapViewOfFile(first_view);
+				else
+					VirtualFree(placeholder, 0, MEM_RELEASE);
+				if (second_view != nullptr)
+					UnmapViewOfFile(second_view);
+				else
+					VirtualFree(placeholder + number_of_bytes, 0, MEM_RELEASE);
+				return region;
+			}
+			region.memory = placeholder;
+		#elif AEH_LINUX
+			// Anonymous file whose pages are mapped at both halves of a reservation. The mappings keep the file
+			// alive after its descriptor is closed.
+			int const file = memfd_create("aeh_mirrored_memory", MFD_CLOEXEC);
+			if (file == -1)
+				return region;
+			if (ftruncate(file, static_cast<off_t>(number_of_bytes)) != 0)
+			{
+				close(file);
+				return region;
+			}
+
+			void * const reservation = mmap(nullptr, 2 * number_of_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (reservation == MAP_FAILED)
+			{
+				close(file);
+				return region;
+			}
+
+			char * const begin = static_cast<char *>(reservation);
+			bool const mapped =
+				mmap(begin, number_of_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file, 0) != MAP_FAILED &&
+				mmap(begin + number_of_bytes, number_of_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file, 0) != MAP_FAILED;
+			close(file);
+
+			if (!mapped)
+			{
+				munmap(reservation, 2 * number_of_bytes);
+				return region;
+			}
+			region.memory = reservation;
+		#endif
+
+		region.mirrored_size = number_of_bytes;
+		return region;
+	}
+
+	auto MirroredMemoryRegion::free_mirrored_memory_region() noexcept -> bool
+	{
+		if (memory == nullptr)
+			return true;
+
+		#if AEH_WINDOWS
+			char * const begin = static_cast<char *>(memory);
+			if (!UnmapViewOfFile(begin) || !UnmapViewOfFile(begin + mirrored_size))
+				return false;
+		#elif AEH_LINUX
+			if (munmap(memory, 2 * mirrored_size) != 0)
+				return false;
+		#endif
+
+		memory = nullptr;
+		mirrored_size = 0;
+		return true;
+	}
+
 } // namespace aeh
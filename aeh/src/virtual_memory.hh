@@ -6,9 +6,32 @@ namespace aeh
 {
 
 	extern size_t const os_memory_page_size;
+	// Size of the pages a region asking for PageSize::huge would use, or 0 where regions never use them (Windows).
+	// It doesn't say whether this system can actually provide them; the page_size() of a region tells whether it did.
+	extern size_t const huge_memory_page_size;
 
 	auto align_to_os_memory_page_boundary(size_t n) noexcept -> size_t;
 
+	enum struct PageSize
+	{
+		os_default,
+		// Fewer TLB misses for big regions. On Linux, explicit huge pages (MAP_HUGETLB) are used if the system has enough
+		// of them reserved, and otherwise transparent huge pages are requested with madvise(MADV_HUGEPAGE). If neither
+		// is available, and on Windows, where large pages can't be reserved without committing them, the region
+		// falls back to the default page size. Memory is committed and decommitted in whole huge pages.
+		huge,
+	};
+
+	// Whether committing memory also faults its pages in. Committed pages normally get physical memory on their first
+	// touch, one page fault at a time, which is a latency spike for whoever touches them. Prefaulting moves that cost
+	// to the commit. On Linux it uses madvise(MADV_POPULATE_WRITE) where the kernel supports it, and otherwise, and on
+	// Windows, writes to every page.
+	enum struct Prefault
+	{
+		no,
+		yes,
+	};
+
 	struct VirtualMemoryRegion
 	{
 		VirtualMemoryRegion() noexcept = default;
@@ -18,19 +41,32 @@ namespace aeh
 		auto operator = (VirtualMemoryRegion && other) noexcept -> VirtualMemoryRegion &;
 		~VirtualMemoryRegion();
 
-		[[nodiscard]] static auto reserve_bytes_of_virtual_memory(size_t number_of_bytes) noexcept -> VirtualMemoryRegion;
-		[[nodiscard]] static auto reserve_pages_of_virtual_memory(size_t number_of_pages) noexcept -> VirtualMemoryRegion;
+		[[nodiscard]] static auto reserve_bytes_of_virtual_memory(size_t number_of_bytes, PageSize page_size = PageSize::os_default) noexcept -> VirtualMemoryRegion;
+		[[nodiscard]] static auto reserve_pages_of_virtual_memory(size_t number_of_pages, PageSize page_size = PageSize::os_default) noexcept -> VirtualMemoryRegion;
+
+		// Non-owning view of part of the pages reserved by this region, which can commit and decommit physical memory
+		// independently of the region and of other views. Freeing a view only decommits its pages. The pages must not
+		// be committed through this region too, and views must be destroyed before this region.
+		[[nodiscard]] auto subregion(size_t first_page, size_t number_of_pages) const noexcept -> VirtualMemoryRegion;
+		[[nodiscard]] auto owns_virtual_memory() const noexcept -> bool { return owns_reservation; }
 
 		[[nodiscard]] auto memory_region_address() const noexcept -> void * { return memory; }
 		[[nodiscard]] auto physical_memory_size_in_bytes() const noexcept -> size_t { return physical_memory_backed_size; }
-		[[nodiscard]] auto physical_memory_size_in_pages() const noexcept -> size_t { return physical_memory_backed_size / os_memory_page_size; }
+		[[nodiscard]] auto physical_memory_size_in_pages() const noexcept -> size_t { return physical_memory_backed_size / memory_page_size; }
 		[[nodiscard]] auto virtual_memory_size_in_bytes() const noexcept -> size_t { return virtual_region_size; }
-		[[nodiscard]] auto virtual_memory_size_in_pages() const noexcept -> size_t { return virtual_region_size / os_memory_page_size; }
+		[[nodiscard]] auto virtual_memory_size_in_pages() const noexcept -> size_t { return virtual_region_size / memory_page_size; }
+		// All sizes in pages, and the number of pages to commit or decommit, are in pages of this size. It is either
+		// os_memory_page_size or huge_memory_page_size, depending on what the region could get when it was reserved.
+		[[nodiscard]] auto page_size() const noexcept -> size_t { return memory_page_size; }
+		[[nodiscard]] auto align_to_page_boundary(size_t n) const noexcept -> size_t;
 
 		// Return false and leave the class unchanged when the underlying system call fails.
-		auto allocate_extra_pages_of_physical_memory(size_t number_of_pages) noexcept -> bool;
+		auto allocate_extra_pages_of_physical_memory(size_t number_of_pages, Prefault prefault = Prefault::no) noexcept -> bool;
 		auto free_pages_of_physical_memory(size_t number_of_pages) noexcept -> bool;
 		auto free_all_pages_of_physical_memory_up_to(size_t number_of_pages_to_keep) noexcept -> bool;
+		// Lets the system take back the physical memory of committed pages whenever it needs it, without decommitting
+		// them. Their contents are undefined afterwards until they are written to.
+		auto discard_pages_of_physical_memory(size_t first_page, size_t number_of_pages) noexcept -> bool;
 
 		// Free all resources and put the object into default-constructed/moved-from state. This state is partially formed.
 		auto free_virtual_memory_region() noexcept -> bool;
@@ -39,6 +75,38 @@ namespace aeh
 		void * memory = nullptr;
 		size_t physical_memory_backed_size = 0;
 		size_t virtual_region_size = 0;
+		size_t memory_page_size = os_memory_page_size;
+		bool owns_reservation = true;
+	};
+
+	// Committed memory whose pages are mapped twice, one copy right after the other, so that memory_region_address()[i]
+	// and memory_region_address()[i + size_in_bytes()] are the same byte. A window that starts in the first copy and
+	// runs past its end continues at the beginning of the memory, which is what ring buffers need to hand out
+	// contiguous spans. Sizes are rounded up to mirrored_memory_granularity.
+	struct MirroredMemoryRegion
+	{
+		MirroredMemoryRegion() noexcept = default;
+		MirroredMemoryRegion(MirroredMemoryRegion const &) = delete;
+		MirroredMemoryRegion(MirroredMemoryRegion && other) noexcept;
+		auto operator = (MirroredMemoryRegion const &) -> MirroredMemoryRegion & = delete;
+		auto operator = (MirroredMemoryRegion && other) noexcept -> MirroredMemoryRegion &;
+		~MirroredMemoryRegion();
+
+		// Returns an empty region if the system call fails.
+		[[nodiscard]] static auto map_bytes_of_mirrored_memory(size_t number_of_bytes) noexcept -> MirroredMemoryRegion;
+
+		[[nodiscard]] auto memory_region_address() const noexcept -> void * { return memory; }
+		// Size of one copy. The mapping spans twice as many bytes.
+		[[nodiscard]] auto size_in_bytes() const noexcept -> size_t { return mirrored_size; }
+
+		auto free_mirrored_memory_region() noexcept -> bool;
+
+	private:
+		void * memory = nullptr;
+		size_t mirrored_size = 0;
 	};
 
+	// Sizes of mirrored regions are a multiple of this. The page size on Linux and the allocation granularity on Windows.
+	extern size_t const mirrored_memory_granularity;
+
 } // namespace aeh
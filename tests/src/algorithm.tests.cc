@@ -1,6 +1,7 @@
 #include "algorithm.hh"
 #include "fixed_capacity_vector.hh"
 #include <catch2/catch_test_macros.hpp>
+#include <vector>
 
 using test_vector = aeh::fixed_capacity_vector<int, 8>;
 
@@ -27,3 +28,22 @@ TEST_CASE("aeh::update_then_erase_if calls the given potentially mutating functi
 	REQUIRE(v == test_vector{1, 2, 3, 2, 3});
 	REQUIRE(erased_count == 3);
 }
+
+TEST_CASE("aeh::branchless_lower_bound finds the same position as std::lower_bound")
+{
+	std::vector<int> values;
+	for (int size = 0; size < 40; ++size)
+	{
+		for (int value = -1; value <= 2 * size + 1; ++value)
+		{
+			auto const expected = std::lower_bound(values.begin(), values.end(), value);
+			REQUIRE(aeh::branchless_lower_bound(values.begin(), values.end(), value) == expected);
+		}
+		// Even numbers, with every other one repeated.
+		values.push_back(2 * (size / 2) + 2 * (size % 2 == 0 ? 0 : 1));
+		std::sort(values.begin(), values.end());
+	}
+
+	std::vector<int> const descending = {9, 7, 7, 4, 1};
+	REQUIRE(aeh::branchless_lower_bound(descending.begin(), descending.end(), 7, std::greater<>()) == descending.begin() + 1);
+}
@@ -1,5 +1,6 @@
 #include "batched_parallel_work.hh"
 #include <catch2/catch_test_macros.hpp>
+#include <memory>
 #include <optional>
 
 namespace tests
@@ -30,6 +31,19 @@ namespace tests
     };
     constexpr auto do_nothing = [](auto && ...) { return worker_on_strike(); };
 
+    // Not default constructible and move-only. Counts live instances to check that every result is destroyed.
+    struct counted_result
+    {
+        counted_result(size_t value_, std::atomic<int> & live_) : value(std::make_unique<size_t>(value_)), live(&live_) { ++*live; }
+        counted_result(counted_result && other) noexcept : value(std::move(other.value)), live(other.live) { ++*live; }
+        counted_result(counted_result const &) = delete;
+        auto operator = (counted_result const &) -> counted_result & = delete;
+        ~counted_result() { --*live; }
+
+        std::unique_ptr<size_t> value;
+        std::atomic<int> * live;
+    };
+
 } // namespace tests
 
 TEST_CASE("Work is executed and the results processed")
@@ -47,3 +61,324 @@ TEST_CASE("Work is executed and the results processed")
     for (size_t i : outputs)
         CHECK(i % 2 != 0);
 }
+
+TEST_CASE("Work stealing scheduling processes every result exactly once and in order")
+{
+    constexpr size_t task_count = 100003;
+    constexpr size_t batch_size = 64;
+
+    std::vector<size_t> outputs;
+    outputs.reserve(task_count);
+
+    aeh::BatchedParallelWorkOptions options;
+    options.scheduling = aeh::BatchedParallelWorkScheduling::work_stealing;
+
+    aeh::batched_parallel_work(
+        task_count, batch_size, std::max(std::thread::hardware_concurrency(), 4u) - 1,
+        [](size_t i) { return i; }, [&outputs](size_t results[], size_t result_count) { outputs.insert(outputs.end(), results, results + result_count); },
+        aeh::run_in_new_thread, options);
+
+    REQUIRE(outputs.size() == task_count);
+    for (size_t i = 0; i < task_count; ++i)
+        REQUIRE(outputs[i] == i);
+}
+
+TEST_CASE("With work stealing, the calling thread steals the work of workers that never run")
+{
+    constexpr size_t task_count = 1000;
+    constexpr size_t batch_size = 10;
+
+    std::vector<size_t> outputs;
+
+    aeh::BatchedParallelWorkOptions options;
+    options.scheduling = aeh::BatchedParallelWorkScheduling::work_stealing;
+
+    aeh::batched_parallel_work(
+        task_count, batch_size, 7,
+        tests::filter_out_evens, tests::push_back_to_if_valid(outputs),
+        tests::do_nothing, options);
+
+    REQUIRE(outputs.size() == task_count / 2);
+    for (size_t i = 0; i < outputs.size(); ++i)
+        REQUIRE(outputs[i] == 2 * i + 1);
+}
+
+TEST_CASE("Workers can claim tasks in chunks bigger than one, even if chunks and batches don't line up")
+{
+    constexpr size_t task_count = 10007;
+    constexpr size_t batch_size = 100;
+
+    for (auto const scheduling : {aeh::BatchedParallelWorkScheduling::shared_index, aeh::BatchedParallelWorkScheduling::work_stealing})
+    {
+        for (size_t const grain : {1u, 7u, 100u, 256u, 20000u})
+        {
+            std::vector<size_t> outputs;
+
+            aeh::BatchedParallelWorkOptions options;
+            options.scheduling = scheduling;
+            options.grain = grain;
+
+            aeh::batched_parallel_work(
+                task_count, batch_size, 3,
+                [](size_t i) { return i; }, [&outputs](size_t results[], size_t result_count) { outputs.insert(outputs.end(), results, results + result_count); },
+                aeh::run_in_new_thread, options);
+
+            REQUIRE(outputs.size() == task_count);
+            for (size_t i = 0; i < task_count; ++i)
+                REQUIRE(outputs[i] == i);
+        }
+    }
+}
+
+TEST_CASE("In streaming mode, workers never get more than max_batches_in_flight batches ahead of process")
+{
+    constexpr size_t task_count = 5003;
+    constexpr size_t batch_size = 10;
+    constexpr size_t max_batches_in_flight = 4;
+
+    std::atomic<size_t> tasks_executed = 0;
+    size_t tasks_processed = 0;
+    bool window_respected = true;
+    std::vector<size_t> outputs;
+
+    aeh::BatchedParallelWorkOptions options;
+    options.max_batches_in_flight = max_batches_in_flight;
+    options.grain = 3;
+
+    aeh::batched_parallel_work(
+        task_count, batch_size, 3,
+        [&tasks_executed](size_t i) { tasks_executed++; return i; },
+        [&](size_t results[], size_t result_count)
+        {
+            // Results of this batch and at most max_batches_in_flight - 1 later batches can exist at this point.
+            window_respected = window_respected && tasks_executed <= tasks_processed + max_batches_in_flight * batch_size;
+            tasks_processed += result_count;
+            outputs.insert(outputs.end(), results, results + result_count);
+            std::this_thread::yield(); // Slow consumer.
+        },
+        aeh::run_in_new_thread, options);
+
+    REQUIRE(window_respected);
+    REQUIRE(outputs.size() == task_count);
+    for (size_t i = 0; i < task_count; ++i)
+        REQUIRE(outputs[i] == i);
+}
+
+TEST_CASE("Results need not be default constructible nor copyable, and are destroyed after being processed")
+{
+    constexpr size_t task_count = 1003;
+    constexpr size_t batch_size = 10;
+
+    for (size_t const max_batches_in_flight : {0u, 4u})
+    {
+        std::atomic<int> live = 0;
+        std::vector<std::unique_ptr<size_t>> outputs;
+
+        aeh::BatchedParallelWorkOptions options;
+        options.max_batches_in_flight = max_batches_in_flight;
+
+        aeh::batched_parallel_work(
+            task_count, batch_size, 3,
+            [&live](size_t i) { return tests::counted_result(i, live); },
+            [&outputs](tests::counted_result results[], size_t result_count)
+            {
+                for (size_t i = 0; i < result_count; ++i)
+                    outputs.push_back(std::move(results[i].value));
+            },
+            aeh::run_in_new_thread, options);
+
+        REQUIRE(live == 0);
+        REQUIRE(outputs.size() == task_count);
+        for (size_t i = 0; i < task_count; ++i)
+            REQUIRE(*outputs[i] == i);
+    }
+}
+
+TEST_CASE("Returning stop from process stops the job early and reports how much work was processed")
+{
+    constexpr size_t task_count = 1000000;
+    constexpr size_t batch_size = 100;
+    constexpr size_t batches_to_process = 5;
+
+    for (size_t const max_batches_in_flight : {0u, 4u})
+    for (auto const scheduling : {aeh::BatchedParallelWorkScheduling::shared_index, aeh::BatchedParallelWorkScheduling::work_stealing})
+    {
+        std::atomic<int> live = 0;
+        std::atomic<size_t> tasks_executed = 0;
+        size_t process_calls = 0;
+
+        aeh::BatchedParallelWorkOptions options;
+        options.scheduling = scheduling;
+        options.max_batches_in_flight = max_batches_in_flight;
+        options.grain = 7;
+
+        aeh::BatchedParallelWorkProgress const progress = aeh::batched_parallel_work(
+            task_count, batch_size, 3,
+            [&](size_t i) { tasks_executed++; return tests::counted_result(i, live); },
+            [&](tests::counted_result[], size_t)
+            {
+                process_calls++;
+                return process_calls == batches_to_process ? aeh::BatchedParallelWorkFlow::stop : aeh::BatchedParallelWorkFlow::keep_going;
+            },
+            aeh::run_in_new_thread, options);
+
+        REQUIRE(progress.stopped);
+        REQUIRE(progress.processed_work == batches_to_process * batch_size);
+        REQUIRE(process_calls == batches_to_process);
+        REQUIRE(tasks_executed < task_count);
+        REQUIRE(live == 0);
+    }
+}
+
+TEST_CASE("Requesting a stop on the stop token of the options stops the job")
+{
+    constexpr size_t task_count = 1000000;
+    constexpr size_t batch_size = 100;
+
+    std::stop_source stop_source;
+    std::atomic<int> live = 0;
+    std::atomic<size_t> tasks_executed = 0;
+    size_t processed_work = 0;
+
+    aeh::BatchedParallelWorkOptions options;
+    options.stop_token = stop_source.get_token();
+
+    aeh::BatchedParallelWorkProgress const progress = aeh::batched_parallel_work(
+        task_count, batch_size, 3,
+        [&](size_t i)
+        {
+            if (i == 1000)
+                stop_source.request_stop();
+            tasks_executed++;
+            return tests::counted_result(i, live);
+        },
+        [&](tests::counted_result[], size_t result_count) { processed_work += result_count; },
+        aeh::run_in_new_thread, options);
+
+    REQUIRE(progress.stopped);
+    REQUIRE(progress.processed_work == processed_work);
+    REQUIRE(progress.processed_work % batch_size == 0);
+    REQUIRE(tasks_executed < task_count);
+    REQUIRE(live == 0);
+}
+
+TEST_CASE("A job that is not stopped reports all its work as processed")
+{
+    size_t const task_count = 1003;
+    aeh::BatchedParallelWorkProgress const progress = aeh::batched_parallel_work(task_count, 10, 3, [](size_t i) { return i; }, [](size_t[], size_t) {});
+
+    REQUIRE(!progress.stopped);
+    REQUIRE(progress.processed_work == task_count);
+}
+
+TEST_CASE("Adaptive batch sizing keeps results in order and batch sizes within bounds")
+{
+    constexpr size_t task_count = 200003;
+    constexpr size_t min_batch_size = 16;
+    constexpr size_t max_batch_size = 4096;
+
+    for (size_t const max_batches_in_flight : {0u, 8u})
+    {
+        std::vector<size_t> outputs;
+        std::vector<size_t> sizes_seen;
+
+        aeh::BatchedParallelWorkOptions options;
+        options.max_batch_size = max_batch_size;
+        options.max_batches_in_flight = max_batches_in_flight;
+        options.grain = 5;
+
+        aeh::BatchedParallelWorkProgress const progress = aeh::batched_parallel_work(
+            task_count, min_batch_size, 3,
+            [](size_t i) { return i; },
+            [&](size_t results[], size_t result_count)
+            {
+                sizes_seen.push_back(result_count);
+                outputs.insert(outputs.end(), results, results + result_count);
+            },
+            aeh::run_in_new_thread, options);
+
+        REQUIRE(!progress.stopped);
+        REQUIRE(progress.batch_sizes == sizes_seen);
+        for (size_t i = 0; i + 1 < sizes_seen.size(); ++i)
+        {
+            REQUIRE(sizes_seen[i] >= min_batch_size);
+            REQUIRE(sizes_seen[i] <= max_batch_size);
+        }
+
+        REQUIRE(outputs.size() == task_count);
+        for (size_t i = 0; i < task_count; ++i)
+            REQUIRE(outputs[i] == i);
+    }
+}
+
+TEST_CASE("Adaptive batch sizing makes batches of cheap tasks bigger and batches of expensive tasks smaller")
+{
+    aeh::BatchedParallelWorkOptions options;
+    options.max_batch_size = 1000;
+
+    // A few nanoseconds per task. Batches grow to the maximum size.
+    options.target_batch_duration = std::chrono::milliseconds(10);
+    aeh::BatchedParallelWorkProgress const cheap = aeh::batched_parallel_work(
+        1000000, 10, 1, [](size_t i) { return i; }, [](size_t[], size_t) {}, tests::do_nothing, options);
+    REQUIRE(*std::max_element(cheap.batch_sizes.begin(), cheap.batch_sizes.end()) == options.max_batch_size);
+
+    // A millisecond per task. Batches stay at the minimum size.
+    options.target_batch_duration = std::chrono::microseconds(100);
+    aeh::BatchedParallelWorkProgress const expensive = aeh::batched_parallel_work(
+        100, 1, 1, [](size_t i) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); return i; }, [](size_t[], size_t) {}, tests::do_nothing, options);
+    for (size_t size : expensive.batch_sizes)
+        REQUIRE(size == 1);
+}
+
+TEST_CASE("Adaptive jobs can be stopped")
+{
+    std::atomic<int> live = 0;
+
+    aeh::BatchedParallelWorkOptions options;
+    options.max_batch_size = 256;
+    options.max_batches_in_flight = 4;
+
+    aeh::BatchedParallelWorkProgress const progress = aeh::batched_parallel_work(
+        1000000, 8, 3,
+        [&live](size_t i) { return tests::counted_result(i, live); },
+        [](tests::counted_result[], size_t) { return aeh::BatchedParallelWorkFlow::stop; },
+        aeh::run_in_new_thread, options);
+
+    REQUIRE(progress.stopped);
+    REQUIRE(progress.batch_sizes.size() == 1);
+    REQUIRE(progress.processed_work == progress.batch_sizes[0]);
+    REQUIRE(live == 0);
+}
+
+#ifdef AEH_WITH_BATCHED_PARALLEL_WORK_STATS
+TEST_CASE("Stats record the work of every thread and how many batches were buffered")
+{
+    constexpr size_t task_count = 10007;
+    constexpr size_t batch_size = 10;
+    constexpr size_t worker_count = 3;
+    constexpr size_t max_batches_in_flight = 5;
+
+    aeh::BatchedParallelWorkStats stats;
+    aeh::BatchedParallelWorkOptions options;
+    options.stats = &stats;
+    options.max_batches_in_flight = max_batches_in_flight;
+
+    aeh::batched_parallel_work(task_count, batch_size, worker_count,
+        [](size_t i) { return i; },
+        [](size_t[], size_t) { std::this_thread::sleep_for(std::chrono::microseconds(10)); },
+        aeh::run_in_new_thread, options);
+
+    REQUIRE(stats.threads.size() == worker_count + 1);
+    size_t tasks_performed = 0;
+    for (aeh::BatchedParallelWorkStats::Thread const & thread : stats.threads)
+        tasks_performed += thread.tasks_performed;
+    REQUIRE(tasks_performed == task_count);
+
+    REQUIRE(stats.batches_processed == task_count / batch_size + 1);
+    REQUIRE(stats.time_in_process >= stats.batches_processed * std::chrono::microseconds(10));
+    REQUIRE(stats.peak_batches_waiting >= 1);
+    REQUIRE(stats.peak_batches_waiting <= max_batches_in_flight);
+    REQUIRE(stats.peak_batches_buffered >= 1);
+    REQUIRE(stats.peak_batches_buffered <= max_batches_in_flight);
+}
+#endif // AEH_WITH_BATCHED_PARALLEL_WORK_STATS
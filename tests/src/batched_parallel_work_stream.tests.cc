@@ -0,0 +1,147 @@
+#include "batched_parallel_work_stream.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <thread>
+
+namespace tests
+{
+
+    // Coroutine that starts right away and signals when it finishes, so that tests can wait for it.
+    struct detached_coroutine
+    {
+        struct promise_type
+        {
+            auto get_return_object() noexcept -> detached_coroutine { return {}; }
+            auto initial_suspend() noexcept -> std::suspend_never { return {}; }
+            auto final_suspend() noexcept -> std::suspend_never { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    static void wait_until_set(std::atomic<bool> & flag)
+    {
+        flag.wait(false);
+    }
+
+    static void set_and_notify(std::atomic<bool> & flag)
+    {
+        flag = true;
+        flag.notify_all();
+    }
+
+    // Not default constructible and move-only. Counts live instances to check that every result is destroyed.
+    struct counted_result
+    {
+        counted_result(size_t value_, std::atomic<int> & live_) : value(std::make_unique<size_t>(value_)), live(&live_) { ++*live; }
+        counted_result(counted_result && other) noexcept : value(std::move(other.value)), live(other.live) { ++*live; }
+        counted_result(counted_result const &) = delete;
+        auto operator = (counted_result const &) -> counted_result & = delete;
+        ~counted_result() { --*live; }
+
+        std::unique_ptr<size_t> value;
+        std::atomic<int> * live;
+    };
+
+    static auto consume_all(size_t total_work, size_t batch_size, aeh::ThreadPool & pool, aeh::BatchedParallelWorkOptions options,
+        std::vector<size_t> & outputs, std::atomic<bool> & done) -> detached_coroutine
+    {
+        auto stream = aeh::batched_parallel_work_stream(total_work, batch_size, pool.thread_count(),
+            [](size_t i) { return i * 3; }, pool, options);
+
+        for (std::span<size_t> batch = co_await stream.next(); !batch.empty(); batch = co_await stream.next())
+            outputs.insert(outputs.end(), batch.begin(), batch.end());
+
+        set_and_notify(done);
+    }
+
+    static auto consume_some(size_t total_work, size_t batches_to_consume, size_t worker_count, std::chrono::microseconds task_time,
+        aeh::ThreadPool & pool, std::atomic<int> & live, size_t & consumed, std::atomic<bool> & done) -> detached_coroutine
+    {
+        {
+            aeh::BatchedParallelWorkOptions options;
+            options.max_batches_in_flight = 2;
+            auto stream = aeh::batched_parallel_work_stream(total_work, 10, worker_count,
+                [&live, task_time](size_t i)
+                {
+                    if (task_time.count() > 0)
+                        std::this_thread::sleep_for(task_time);
+                    return counted_result(i, live);
+                }, pool, options);
+
+            for (size_t i = 0; i < batches_to_consume; ++i)
+            {
+                std::span<counted_result> const batch = co_await stream.next();
+                for (counted_result const & result : batch)
+                    if (*result.value == consumed)
+                        consumed++;
+            }
+        }
+
+        set_and_notify(done);
+    }
+
+} // namespace tests
+
+TEST_CASE("A batched parallel work stream yields every result in order")
+{
+    aeh::ThreadPool pool(3);
+
+    for (size_t const task_count : {0u, 1u, 99u, 100u, 10007u})
+    {
+        for (size_t const max_batches_in_flight : {0u, 1u, 4u})
+        {
+            aeh::BatchedParallelWorkOptions options;
+            options.max_batches_in_flight = max_batches_in_flight;
+            options.grain = 4;
+
+            std::vector<size_t> outputs;
+            std::atomic<bool> done = false;
+            tests::consume_all(task_count, 10, pool, options, outputs, done);
+            tests::wait_until_set(done);
+
+            REQUIRE(outputs.size() == task_count);
+            for (size_t i = 0; i < task_count; ++i)
+                REQUIRE(outputs[i] == i * 3);
+        }
+    }
+}
+
+TEST_CASE("Destroying a batched parallel work stream early stops the workers and destroys every result")
+{
+    aeh::ThreadPool pool(4);
+
+    for (size_t const batches_to_consume : {0u, 1u, 5u})
+    {
+        std::atomic<int> live = 0;
+        size_t consumed = 0;
+        std::atomic<bool> done = false;
+        tests::consume_some(100000, batches_to_consume, pool.thread_count(), std::chrono::microseconds(0), pool, live, consumed, done);
+        tests::wait_until_set(done);
+
+        REQUIRE(consumed == batches_to_consume * 10);
+        REQUIRE(live == 0);
+    }
+}
+
+TEST_CASE("A batched parallel work stream can be destroyed from a pool thread while some of its workers are still queued")
+{
+    // With one pool thread, the consumer is resumed by the only worker that runs, and the second worker is queued
+    // behind it until the stream is destroyed.
+    aeh::ThreadPool pool(1);
+
+    for (size_t const batches_to_consume : {1u, 3u})
+    {
+        std::atomic<int> live = 0;
+        size_t consumed = 0;
+        std::atomic<bool> done = false;
+        tests::consume_some(1000, batches_to_consume, 2, std::chrono::microseconds(200), pool, live, consumed, done);
+        tests::wait_until_set(done);
+
+        REQUIRE(consumed == batches_to_consume * 10);
+        REQUIRE(live == 0);
+    }
+}
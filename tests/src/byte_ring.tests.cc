@@ -0,0 +1,100 @@
+#include "byte_ring.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace tests
+{
+
+	static auto as_bytes(char const * text) -> std::span<std::byte const>
+	{
+		return std::as_bytes(std::span<char const>(text, std::strlen(text)));
+	}
+
+	static auto equals(std::span<std::byte const> bytes, char const * text) -> bool
+	{
+		return bytes.size() == std::strlen(text) && std::memcmp(bytes.data(), text, bytes.size()) == 0;
+	}
+
+} // namespace tests
+
+TEST_CASE("Default constructed byte_ring has no capacity")
+{
+	aeh::byte_ring ring;
+	REQUIRE(ring.empty());
+	REQUIRE(ring.full());
+	REQUIRE(ring.capacity() == 0);
+	REQUIRE(ring.write(tests::as_bytes("a")) == 0);
+}
+
+TEST_CASE("Capacity of a byte_ring is rounded up to the mirrored memory granularity")
+{
+	aeh::byte_ring ring(100);
+	REQUIRE(ring.capacity() == aeh::mirrored_memory_granularity);
+	REQUIRE(ring.free_space() == ring.capacity());
+	REQUIRE(ring.writable().size() == ring.capacity());
+}
+
+TEST_CASE("Bytes come out of a byte_ring in the order they went in")
+{
+	aeh::byte_ring ring(1);
+	REQUIRE(ring.write(tests::as_bytes("hello ")) == 6);
+	REQUIRE(ring.write(tests::as_bytes("world")) == 5);
+	REQUIRE(tests::equals(ring.readable(), "hello world"));
+
+	ring.consume(6);
+	REQUIRE(tests::equals(ring.readable(), "world"));
+
+	char out[8] = {};
+	REQUIRE(ring.read(std::as_writable_bytes(std::span(out))) == 5);
+	REQUIRE(std::strcmp(out, "world") == 0);
+	REQUIRE(ring.empty());
+}
+
+TEST_CASE("Readable and writable parts of a byte_ring are contiguous across the end of the buffer")
+{
+	aeh::byte_ring ring(1);
+	size_t const capacity = ring.capacity();
+
+	// Move the start close to the end of the buffer.
+	std::vector<std::byte> const filler(capacity - 3);
+	REQUIRE(ring.write(filler) == filler.size());
+	ring.consume(filler.size() - 1);
+	REQUIRE(ring.size() == 1);
+
+	REQUIRE(ring.writable().size() == capacity - 1);
+	REQUIRE(ring.write(tests::as_bytes("abcdef")) == 6);
+	ring.consume(1);
+	REQUIRE(tests::equals(ring.readable(), "abcdef"));
+
+	// Fill it up. The writable span crosses the end of the buffer and the readable span covers all of it.
+	std::span<std::byte> const writable = ring.writable();
+	REQUIRE(writable.size() == capacity - 6);
+	std::iota(reinterpret_cast<unsigned char *>(writable.data()), reinterpret_cast<unsigned char *>(writable.data() + writable.size()), static_cast<unsigned char>(0));
+	ring.commit_write(writable.size());
+	REQUIRE(ring.full());
+	REQUIRE(ring.write(tests::as_bytes("x")) == 0);
+
+	std::span<std::byte const> const readable = std::as_const(ring).readable();
+	REQUIRE(readable.size() == capacity);
+	REQUIRE(tests::equals(readable.first(6), "abcdef"));
+	for (size_t i = 6; i < capacity; ++i)
+		REQUIRE(readable[i] == static_cast<std::byte>(static_cast<unsigned char>(i - 6)));
+}
+
+TEST_CASE("Moving a byte_ring keeps its contents")
+{
+	aeh::byte_ring a(1);
+	a.write(tests::as_bytes("abc"));
+
+	aeh::byte_ring b = std::move(a);
+	REQUIRE(a.capacity() == 0);
+	REQUIRE(tests::equals(b.readable(), "abc"));
+
+	a = std::move(b);
+	REQUIRE(tests::equals(a.readable(), "abc"));
+	a.clear();
+	REQUIRE(a.empty());
+}
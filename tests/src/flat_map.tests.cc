@@ -0,0 +1,134 @@
+#include "flat_map.hh"
+#include "fixed_capacity_vector.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE("A flat_map built from keys and values sorts them by key")
+{
+	aeh::flat_map<int, std::string> const map({3, 1, 2, 1}, {"three", "one", "two", "uno"});
+	REQUIRE(map.size() == 3);
+	REQUIRE(std::ranges::equal(map.keys(), std::vector<int>{1, 2, 3}));
+	// The first of duplicate keys is kept.
+	REQUIRE(std::ranges::equal(map.values(), std::vector<std::string>{"one", "two", "three"}));
+
+	REQUIRE(map.find(2)->second == "two");
+	REQUIRE(map.find(4) == map.end());
+	REQUIRE(map.contains(3));
+	REQUIRE(map.count(0) == 0);
+}
+
+TEST_CASE("Pairs inserted in a flat_map stay sorted")
+{
+	aeh::flat_map<std::string, int> map = {{"b", 2}, {"d", 4}};
+
+	REQUIRE(map.insert("c", 3).second);
+	REQUIRE(!map.insert("c", 30).second);
+	REQUIRE(map.find("c")->second == 3);
+
+	REQUIRE(!map.insert_or_assign("c", 30).second);
+	REQUIRE(map.find("c")->second == 30);
+
+	map["a"] = 1;
+	map["b"] += 20;
+	map.insert_range(std::vector<std::pair<std::string, int>>{{"e", 5}, {"a", 100}});
+	REQUIRE(std::ranges::equal(map.keys(), std::vector<std::string>{"a", "b", "c", "d", "e"}));
+	REQUIRE(std::ranges::equal(map.values(), std::vector<int>{1, 22, 30, 4, 5}));
+
+	REQUIRE(map.erase("c") == 1);
+	REQUIRE(map.erase("c") == 0);
+	auto const after_a = map.erase(map.find("a"));
+	REQUIRE(after_a->first == "b");
+
+	std::vector<std::string> visited;
+	for (auto [key, value] : map)
+	{
+		value++;
+		visited.push_back(key);
+	}
+	REQUIRE(visited == std::vector<std::string>{"b", "d", "e"});
+	REQUIRE(std::ranges::equal(map.values(), std::vector<int>{23, 5, 6}));
+}
+
+TEST_CASE("A flat_map can be stored in fixed_capacity_vectors")
+{
+	aeh::flat_map<int, float, std::less<int>, aeh::fixed_capacity_vector<int, 16>, aeh::fixed_capacity_vector<float, 16>> map;
+	for (int i = 15; i >= 0; --i)
+		map.insert(i * 2, static_cast<float>(i));
+
+	REQUIRE(map.size() == 16);
+	for (int i = 0; i < 16; ++i)
+	{
+		REQUIRE(map.find(i * 2)->second == static_cast<float>(i));
+		REQUIRE(map.find(i * 2 + 1) == map.end());
+		REQUIRE(map.lower_bound(i * 2 - 1)->first == i * 2);
+	}
+}
+
+TEST_CASE("Inserting ranges into a flat_map matches std::map, keeping the first of equal keys")
+{
+	std::mt19937 rng(42);
+	aeh::flat_map<int, int> flat;
+	std::map<int, int> tree;
+	for (int batch = 0; batch < 20; ++batch)
+	{
+		std::vector<std::pair<int, int>> pairs(static_cast<size_t>(rng() % 200));
+		for (auto & [key, value] : pairs)
+		{
+			key = static_cast<int>(rng() % 1000);
+			value = static_cast<int>(rng());
+		}
+
+		flat.insert_range(pairs);
+		tree.insert(pairs.begin(), pairs.end());
+		REQUIRE(std::ranges::equal(flat, tree, [](auto const & a, auto const & b) { return a.first == b.first && a.second == b.second; }));
+	}
+}
+
+TEST_CASE("Inserting a range into a flat_map doesn't need room for keys it already has")
+{
+	using fixed_map = aeh::flat_map<int, int, std::less<int>, aeh::fixed_capacity_vector<int, 4>, aeh::fixed_capacity_vector<int, 4>>;
+	fixed_map map = {{1, 10}, {2, 20}, {3, 30}};
+	map.insert_range(std::vector<std::pair<int, int>>{{3, 0}, {2, 0}, {1, 0}, {0, 0}});
+	REQUIRE(std::ranges::equal(map.keys(), std::vector<int>{0, 1, 2, 3}));
+	REQUIRE(std::ranges::equal(map.values(), std::vector<int>{0, 10, 20, 30}));
+}
+
+TEST_CASE("flat_map vs std::map lookups in small tables", "[.][benchmark]")
+{
+	for (int const size : {16, 256})
+	{
+		std::mt19937 rng(size);
+		std::vector<int> keys(size);
+		for (int & key : keys)
+			key = static_cast<int>(rng() % 100'000);
+		std::vector<int> lookups(1024);
+		for (int & lookup : lookups)
+			lookup = keys[rng() % keys.size()];
+
+		std::map<int, int> tree;
+		for (int const key : keys)
+			tree.emplace(key, key);
+		std::vector<int> values = keys;
+		aeh::flat_map<int, int> const flat(std::vector<int>(keys), std::move(values));
+
+		BENCHMARK("std::map, size = " + std::to_string(size))
+		{
+			int total = 0;
+			for (int const key : lookups)
+				total += tree.find(key)->second;
+			return total;
+		};
+
+		BENCHMARK("flat_map, size = " + std::to_string(size))
+		{
+			int total = 0;
+			for (int const key : lookups)
+				total += flat.find(key)->second;
+			return total;
+		};
+	}
+}
@@ -0,0 +1,57 @@
+#include "flat_set.hh"
+#include "fixed_capacity_vector.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+TEST_CASE("A flat_set built from a container sorts it and removes duplicates")
+{
+	aeh::flat_set<int> const set(std::vector<int>{5, 3, 9, 3, 1, 5});
+	REQUIRE(set.size() == 4);
+	REQUIRE(std::ranges::equal(set.keys(), std::vector<int>{1, 3, 5, 9}));
+	REQUIRE(set.contains(3));
+	REQUIRE(!set.contains(4));
+	REQUIRE(set.count(9) == 1);
+	REQUIRE(*set.lower_bound(4) == 5);
+	REQUIRE(*set.upper_bound(5) == 9);
+	REQUIRE(set.find(10) == set.end());
+}
+
+TEST_CASE("Keys inserted in a flat_set stay sorted")
+{
+	aeh::flat_set<std::string> set = {"b", "d"};
+
+	auto const [inserted, was_inserted] = set.insert("c");
+	REQUIRE(was_inserted);
+	REQUIRE(*inserted == "c");
+	REQUIRE(!set.insert("b").second);
+
+	set.insert_range(std::vector<std::string>{"e", "a", "c", "a"});
+	REQUIRE(std::ranges::equal(set.keys(), std::vector<std::string>{"a", "b", "c", "d", "e"}));
+
+	REQUIRE(set.erase("c") == 1);
+	REQUIRE(set.erase("c") == 0);
+	REQUIRE(*set.erase(set.find("a")) == "b");
+	REQUIRE(std::ranges::equal(set.keys(), std::vector<std::string>{"b", "d", "e"}));
+}
+
+TEST_CASE("A flat_set can be stored in a fixed_capacity_vector")
+{
+	using fixed_set = aeh::flat_set<int, std::greater<int>, aeh::fixed_capacity_vector<int, 8>>;
+	fixed_set set = {4, 1, 7};
+	set.insert(5);
+	REQUIRE(std::ranges::equal(set.keys(), std::vector<int>{7, 5, 4, 1}));
+	REQUIRE(set.contains(1));
+	REQUIRE(set == fixed_set{1, 4, 5, 7});
+
+	aeh::fixed_capacity_vector<int, 8> const keys = std::move(set).extract();
+	REQUIRE(keys.size() == 4);
+	REQUIRE(set.empty());
+}
+
+TEST_CASE("Inserting a range into a flat_set doesn't need room for keys it already has")
+{
+	aeh::flat_set<int, std::less<int>, aeh::fixed_capacity_vector<int, 4>> set = {1, 2, 3};
+	set.insert_range(std::vector<int>{3, 2, 1, 0});
+	REQUIRE(std::ranges::equal(set.keys(), std::vector<int>{0, 1, 2, 3}));
+}
@@ -1,5 +1,12 @@
 #include "memory_arena.hh"
+#include "ring.hh"
+#include "json_string_builder.hh"
 #include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
 
 TEST_CASE("Bytes can be allocated from a memory arena")
 {
@@ -62,3 +69,406 @@ TEST_CASE("A MemoryArenaScopeGuard automatically frees all memory allocated whil
 
 	REQUIRE(arena.allocated_bytes() == sizeof(int));
 }
+
+TEST_CASE("Standard containers can allocate from a memory arena through a memory resource")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(1024 * 1024);
+	aeh::MemoryArenaResource resource(arena);
+
+	{
+		auto const guard = aeh::MemoryArenaScopeGuard(arena);
+
+		std::pmr::vector<int> v(&resource);
+		for (int i = 0; i < 1000; ++i)
+			v.push_back(i);
+		std::pmr::string s("A string long enough to not fit in the small string buffer", &resource);
+
+		REQUIRE(arena.allocated_bytes() >= 1000 * sizeof(int) + s.size());
+		REQUIRE(v.back() == 999);
+		REQUIRE(s.get_allocator().resource()->is_equal(resource));
+		REQUIRE(!resource.is_equal(*std::pmr::new_delete_resource()));
+	}
+
+	REQUIRE(arena.allocated_bytes() == 0);
+}
+
+TEST_CASE("A ring can allocate from a memory arena")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(1024 * 1024);
+
+	{
+		auto const guard = aeh::MemoryArenaScopeGuard(arena);
+
+		aeh::ring<int, aeh::MemoryArenaAllocator<int>> r(arena);
+		for (int i = 0; i < 100; ++i)
+			r.push_back(i);
+		for (int i = 0; i < 50; ++i)
+			r.pop_front();
+
+		REQUIRE(r.front() == 50);
+		REQUIRE(&r.get_allocator().arena() == &arena);
+		REQUIRE(arena.allocated_bytes() >= 100 * sizeof(int));
+	}
+
+	REQUIRE(arena.allocated_bytes() == 0);
+}
+
+TEST_CASE("Memory arena allocators compare equal when they allocate from the same arena")
+{
+	auto arena1 = aeh::MemoryArena::with_virtual_region(1024 * 1024);
+	auto arena2 = aeh::MemoryArena::with_virtual_region(1024 * 1024);
+
+	aeh::MemoryArenaAllocator<int> const a(arena1);
+	aeh::MemoryArenaAllocator<double> const b = a;
+
+	REQUIRE(a == b);
+	REQUIRE(a != aeh::MemoryArenaAllocator<int>(arena2));
+}
+
+TEST_CASE("Many threads can allocate from a concurrent memory arena at the same time")
+{
+	constexpr int thread_count = 8;
+	constexpr int allocations_per_thread = 1000;
+	auto arena = aeh::ConcurrentMemoryArena::with_virtual_region(64 * 1024 * 1024);
+
+	std::vector<std::vector<int *>> allocations(thread_count);
+	{
+		std::vector<std::jthread> threads;
+		for (int t = 0; t < thread_count; ++t)
+			threads.emplace_back([&arena, &allocations, t]
+			{
+				for (int i = 0; i < allocations_per_thread; ++i)
+				{
+					// Different sizes so that threads make the arena commit pages at different points.
+					size_t const int_count = 1 + i % 37;
+					int * const p = static_cast<int *>(arena.allocate(int_count * sizeof(int), alignof(int)));
+					std::fill_n(p, int_count, t);
+					allocations[t].push_back(p);
+				}
+			});
+	}
+
+	// Allocations don't overlap, so nothing written by a thread was overwritten by another.
+	for (int t = 0; t < thread_count; ++t)
+		for (int i = 0; i < allocations_per_thread; ++i)
+		{
+			REQUIRE(reinterpret_cast<uintptr_t>(allocations[t][i]) % alignof(int) == 0);
+			for (int j = 0; j < 1 + i % 37; ++j)
+				REQUIRE(allocations[t][i][j] == t);
+		}
+
+	arena.free_all();
+	REQUIRE(arena.allocated_bytes() == 0);
+}
+
+TEST_CASE("Allocations from a concurrent memory arena are aligned")
+{
+	auto arena = aeh::ConcurrentMemoryArena::with_virtual_region(1024 * 1024);
+
+	static_cast<void>(arena.allocate(1, 1));
+	void * const p = arena.allocate(sizeof(double), 64);
+	REQUIRE(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+	REQUIRE(arena.allocated_bytes() == 64 + sizeof(double));
+}
+
+TEST_CASE("A concurrent memory arena returns nullptr when an allocation doesn't fit in its reserved region")
+{
+	auto arena = aeh::ConcurrentMemoryArena::with_virtual_region(64 * 1024, aeh::PageSize::os_default, aeh::Prefault::yes);
+
+	REQUIRE(arena.allocate(60 * 1024, 1) != nullptr);
+	REQUIRE(arena.allocate(16 * 1024, 1) == nullptr);
+	REQUIRE(arena.allocated_bytes() == 60 * 1024);
+
+	// A failed allocation takes no space, so smaller ones still fit.
+	REQUIRE(arena.allocate(4 * 1024, 1) != nullptr);
+	REQUIRE(arena.allocate(1, 1) == nullptr);
+}
+
+TEST_CASE("A memory arena can be backed by huge pages")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(16 * 1024 * 1024, aeh::PageSize::huge);
+
+	constexpr size_t int_count = 1024 * 1024;
+	int * const p = static_cast<int *>(arena.allocate(int_count * sizeof(int), alignof(int)));
+	std::fill_n(p, int_count, 3);
+	REQUIRE(p[int_count - 1] == 3);
+
+	arena.free_all();
+	REQUIRE(arena.allocated_bytes() == 0);
+}
+
+TEST_CASE("Memory committed up front is kept when the arena is freed")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(1024 * 1024);
+
+	arena.commit(arena.reserved_bytes());
+	REQUIRE(arena.committed_bytes() == arena.reserved_bytes());
+
+	int * const p = static_cast<int *>(arena.allocate(1000 * sizeof(int), alignof(int)));
+	std::fill_n(p, 1000, 4);
+	arena.free_all();
+
+	REQUIRE(arena.allocated_bytes() == 0);
+	REQUIRE(arena.committed_bytes() == arena.reserved_bytes());
+}
+
+TEST_CASE("A prefaulting memory arena can be allocated from")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(16 * 1024 * 1024, aeh::PageSize::os_default, aeh::Prefault::yes);
+
+	constexpr size_t int_count = 1024 * 1024;
+	int * const p = static_cast<int *>(arena.allocate(int_count * sizeof(int), alignof(int)));
+	std::fill_n(p, int_count, 5);
+	REQUIRE(p[int_count - 1] == 5);
+}
+
+namespace tests
+{
+
+	// Times every allocation, including writing to the allocated memory, which is when lazily committed pages fault.
+	static void report_allocation_latency(std::string const & name, aeh::MemoryArena & arena)
+	{
+		constexpr size_t allocation_size = 16 * 1024;
+		constexpr size_t allocation_count = 8 * 1024;
+
+		std::vector<std::chrono::nanoseconds> latencies;
+		latencies.reserve(allocation_count);
+		for (size_t i = 0; i < allocation_count; ++i)
+		{
+			auto const start = std::chrono::steady_clock::now();
+			char * const p = static_cast<char *>(arena.allocate(allocation_size, 1));
+			std::fill_n(p, allocation_size, static_cast<char>(i));
+			latencies.push_back(std::chrono::steady_clock::now() - start);
+		}
+		std::sort(latencies.begin(), latencies.end());
+
+		auto const percentile = [&latencies](size_t p) { return std::to_string(latencies[latencies.size() * p / 100].count()) + " ns"; };
+		WARN(name + ": p50 = " + percentile(50) + ", p99 = " + percentile(99) + ", max = " + std::to_string(latencies.back().count()) + " ns");
+	}
+
+} // namespace tests
+
+TEST_CASE("Allocation latency of lazily committed vs prefaulted arenas", "[.][benchmark]")
+{
+	constexpr size_t arena_size = 256 * 1024 * 1024;
+
+	{
+		auto arena = aeh::MemoryArena::with_virtual_region(arena_size);
+		tests::report_allocation_latency("Lazy", arena);
+	}
+	{
+		auto arena = aeh::MemoryArena::with_virtual_region(arena_size, aeh::PageSize::os_default, aeh::Prefault::yes);
+		tests::report_allocation_latency("Prefault on growth", arena);
+	}
+	{
+		auto arena = aeh::MemoryArena::with_virtual_region(arena_size);
+		arena.commit(arena.reserved_bytes());
+		tests::report_allocation_latency("Committed up front", arena);
+	}
+}
+
+namespace tests
+{
+
+	static void use_bytes(aeh::MemoryArena & arena, size_t bytes)
+	{
+		char * const p = static_cast<char *>(arena.allocate(bytes, 1));
+		std::fill_n(p, bytes, 'a');
+		arena.free_all();
+	}
+
+} // namespace tests
+
+TEST_CASE("A memory arena with the never decommit policy keeps all of its memory committed")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(16 * 1024 * 1024);
+	arena.set_decommit_options({.policy = aeh::DecommitPolicy::never});
+
+	tests::use_bytes(arena, 4 * 1024 * 1024);
+	REQUIRE(arena.committed_bytes() >= 4 * 1024 * 1024);
+}
+
+TEST_CASE("A memory arena with the high water mark decommit policy keeps its peak usage committed for a window of frees")
+{
+	constexpr size_t big = 4 * 1024 * 1024;
+	constexpr size_t small = 64 * 1024;
+	auto arena = aeh::MemoryArena::with_virtual_region(16 * 1024 * 1024);
+	arena.set_decommit_options({.policy = aeh::DecommitPolicy::high_water_mark, .window = 3});
+
+	tests::use_bytes(arena, big);
+	REQUIRE(arena.committed_bytes() >= big);
+
+	// Reaching the peak again restarts the window.
+	tests::use_bytes(arena, small);
+	tests::use_bytes(arena, small);
+	tests::use_bytes(arena, big);
+	tests::use_bytes(arena, small);
+	tests::use_bytes(arena, small);
+	REQUIRE(arena.committed_bytes() >= big);
+
+	tests::use_bytes(arena, small);
+	REQUIRE(arena.committed_bytes() >= small);
+	REQUIRE(arena.committed_bytes() < big);
+}
+
+TEST_CASE("A memory arena with the delayed decommit policy keeps its peak usage committed for a while")
+{
+	constexpr size_t big = 4 * 1024 * 1024;
+	constexpr size_t small = 64 * 1024;
+
+	auto arena = aeh::MemoryArena::with_virtual_region(16 * 1024 * 1024);
+	arena.set_decommit_options({.policy = aeh::DecommitPolicy::delayed, .delay = std::chrono::hours(1)});
+	tests::use_bytes(arena, big);
+	tests::use_bytes(arena, small);
+	REQUIRE(arena.committed_bytes() >= big);
+
+	arena.set_decommit_options({.policy = aeh::DecommitPolicy::delayed, .delay = std::chrono::seconds(0)});
+	tests::use_bytes(arena, small);
+	REQUIRE(arena.committed_bytes() < big);
+}
+
+TEST_CASE("A memory arena that releases pages lazily keeps them committed and can reuse them")
+{
+	constexpr size_t big = 4 * 1024 * 1024;
+	auto arena = aeh::MemoryArena::with_virtual_region(16 * 1024 * 1024);
+	arena.set_decommit_options({.release = aeh::PageRelease::lazy});
+
+	tests::use_bytes(arena, big);
+	size_t const committed = arena.committed_bytes();
+	REQUIRE(committed >= big);
+
+	tests::use_bytes(arena, 0);
+	REQUIRE(arena.committed_bytes() == committed);
+
+	// The released pages can be written to again right away.
+	tests::use_bytes(arena, big);
+	REQUIRE(arena.committed_bytes() == committed);
+}
+
+TEST_CASE("Telemetry of a memory arena always has its current sizes")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(1024 * 1024);
+	static_cast<void>(arena.allocate(100, 1));
+
+	aeh::MemoryArenaTelemetry const telemetry = arena.telemetry();
+	REQUIRE(telemetry.allocated_bytes == 100);
+	REQUIRE(telemetry.committed_bytes == arena.committed_bytes());
+	REQUIRE(telemetry.reserved_bytes == arena.reserved_bytes());
+}
+
+TEST_CASE("Memory arena telemetry can be written as JSON")
+{
+	aeh::MemoryArenaTelemetry telemetry;
+	telemetry.name = "frame";
+	telemetry.allocated_bytes = 1;
+	telemetry.peak_allocated_bytes = 2;
+	telemetry.committed_bytes = 3;
+	telemetry.peak_committed_bytes = 4;
+	telemetry.reserved_bytes = 5;
+	telemetry.grow_count = 6;
+	telemetry.shrink_count = 7;
+	telemetry.alignment_padding_bytes = 8;
+
+	std::string str;
+	{
+		auto builder = aeh::json::StringBuilder(str);
+		builder << telemetry;
+	}
+	REQUIRE(str == R"({"name":"frame","allocated_bytes":1,"peak_allocated_bytes":2,"committed_bytes":3,"peak_committed_bytes":4,)"
+		R"("reserved_bytes":5,"grow_count":6,"shrink_count":7,"alignment_padding_bytes":8})");
+}
+
+#ifdef AEH_WITH_MEMORY_ARENA_TELEMETRY
+TEST_CASE("Telemetry tracks peaks, page commits and alignment padding of a memory arena")
+{
+	auto arena = aeh::MemoryArena::with_virtual_region(16 * 1024 * 1024);
+	size_t const grows_at_creation = arena.telemetry().grow_count;
+
+	static_cast<void>(arena.allocate(1, 1));
+	static_cast<void>(arena.allocate(8, 8));
+	REQUIRE(arena.telemetry().alignment_padding_bytes == 7);
+
+	static_cast<void>(arena.allocate(4 * 1024 * 1024, 1));
+	size_t const peak_committed = arena.committed_bytes();
+	arena.free_all();
+
+	aeh::MemoryArenaTelemetry const telemetry = arena.telemetry();
+	REQUIRE(telemetry.allocated_bytes == 0);
+	REQUIRE(telemetry.peak_allocated_bytes == 4 * 1024 * 1024 + 16);
+	REQUIRE(telemetry.committed_bytes < peak_committed);
+	REQUIRE(telemetry.peak_committed_bytes == peak_committed);
+	REQUIRE(telemetry.grow_count == grows_at_creation + 1);
+	REQUIRE(telemetry.shrink_count == 1);
+}
+
+TEST_CASE("The registry has the telemetry of every live memory arena")
+{
+	auto const has_arena_named = [](char const * name)
+	{
+		std::vector<aeh::MemoryArenaTelemetry> const all = aeh::telemetry_of_all_memory_arenas();
+		return std::any_of(all.begin(), all.end(), [name](aeh::MemoryArenaTelemetry const & t) { return t.name == name; });
+	};
+
+	static char const name[] = "registry test";
+	{
+		auto arena = aeh::MemoryArena::with_virtual_region(1024 * 1024);
+		arena.set_telemetry_name(name);
+		static_cast<void>(arena.allocate(10, 1));
+		REQUIRE(has_arena_named(name));
+
+		// Moving the arena moves its telemetry too.
+		aeh::MemoryArena moved = std::move(arena);
+		REQUIRE(moved.telemetry().name == name);
+		REQUIRE(moved.telemetry().peak_allocated_bytes == 10);
+		REQUIRE(arena.telemetry().name == nullptr);
+
+		std::string str;
+		{
+			auto builder = aeh::json::StringBuilder(str);
+			aeh::write_memory_arena_telemetry(builder);
+		}
+		REQUIRE(str.front() == '[');
+		REQUIRE(str.find(R"("name":"registry test","allocated_bytes":10,"peak_allocated_bytes":10)") != std::string::npos);
+	}
+	REQUIRE(!has_arena_named(name));
+}
+#endif // AEH_WITH_MEMORY_ARENA_TELEMETRY
+
+TEST_CASE("Memory from a double buffered memory arena lives until the second flip")
+{
+	auto arenas = aeh::DoubleBufferedMemoryArena::with_virtual_region(1024 * 1024);
+
+	int * const first = static_cast<int *>(arenas.current().allocate(sizeof(int), alignof(int)));
+	*first = 1;
+
+	arenas.flip();
+	REQUIRE(arenas.previous().allocated_bytes() == sizeof(int));
+	REQUIRE(*first == 1);
+	int * const second = static_cast<int *>(arenas.current().allocate(sizeof(int), alignof(int)));
+	*second = 2;
+	REQUIRE(second != first);
+
+	arenas.flip();
+	REQUIRE(arenas.current().allocated_bytes() == 0);
+	REQUIRE(arenas.previous().allocated_bytes() == sizeof(int));
+	REQUIRE(*second == 2);
+}
+
+TEST_CASE("A double buffered memory arena keeps its steady state usage committed")
+{
+	constexpr size_t per_frame = 3 * 1024 * 1024;
+	auto arenas = aeh::DoubleBufferedMemoryArena::with_virtual_region(16 * 1024 * 1024);
+
+	for (int frame = 0; frame < 4; ++frame)
+	{
+		static_cast<void>(arenas.current().allocate(per_frame, 1));
+		arenas.flip();
+	}
+
+	size_t const committed = arenas.current().committed_bytes();
+	REQUIRE(committed >= per_frame);
+	static_cast<void>(arenas.current().allocate(per_frame, 1));
+	arenas.flip();
+	arenas.flip();
+	REQUIRE(arenas.current().committed_bytes() == committed);
+}
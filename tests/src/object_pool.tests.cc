@@ -0,0 +1,211 @@
+#include "object_pool.hh"
+#include "msp/minimalistic_shared_ptr.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace tests
+{
+
+	struct node
+	{
+		node(int value_, int & live_) : value(value_), live(&live_) { ++*live; }
+		~node() { --*live; }
+
+		int value;
+		int * live;
+	};
+
+	struct throws_on_construction
+	{
+		throws_on_construction() { throw std::runtime_error("construction failed"); }
+	};
+
+} // namespace tests
+
+TEST_CASE("A slab allocator reuses freed objects in any order")
+{
+	aeh::SlabAllocator slab(24, 8, 1000);
+	REQUIRE(slab.object_size() == 24);
+
+	std::vector<void *> objects;
+	for (int i = 0; i < 100; ++i)
+		objects.push_back(slab.allocate());
+	REQUIRE(std::set<void *>(objects.begin(), objects.end()).size() == objects.size());
+	for (void * object : objects)
+		REQUIRE(reinterpret_cast<uintptr_t>(object) % 8 == 0);
+
+	// Free from the middle, which an arena can't do.
+	slab.deallocate(objects[50]);
+	REQUIRE(slab.allocate() == objects[50]);
+}
+
+TEST_CASE("A slab allocator has no per-object overhead and commits memory as it needs it")
+{
+	aeh::SlabAllocator slab(16, 16, 1024 * 1024);
+	REQUIRE(slab.committed_bytes() == 0);
+
+	char * const first = static_cast<char *>(slab.allocate());
+	char * const second = static_cast<char *>(slab.allocate());
+	REQUIRE(second - first == 16);
+	REQUIRE(slab.committed_bytes() > 0);
+	REQUIRE(slab.committed_bytes() < 1024 * 1024);
+}
+
+TEST_CASE("A slab allocator returns nullptr when it is full")
+{
+	aeh::SlabAllocator slab(8, 8, 3);
+
+	void * const a = slab.allocate();
+	void * const b = slab.allocate();
+	void * const c = slab.allocate();
+	REQUIRE((a && b && c));
+	REQUIRE(slab.allocate() == nullptr);
+
+	slab.deallocate(b);
+	REQUIRE(slab.allocate() == b);
+}
+
+TEST_CASE("An object pool constructs and destroys the objects it allocates")
+{
+	int live = 0;
+	aeh::ObjectPool<tests::node> pool(100);
+
+	tests::node * const a = pool.create(1, live);
+	tests::node * const b = pool.create(2, live);
+	REQUIRE(live == 2);
+	REQUIRE(a->value == 1);
+	REQUIRE(b->value == 2);
+
+	pool.destroy(a);
+	REQUIRE(live == 1);
+	pool.destroy(b);
+	REQUIRE(live == 0);
+}
+
+TEST_CASE("An object pool gives back the memory of objects whose constructor throws")
+{
+	aeh::ObjectPool<tests::throws_on_construction> pool(1);
+
+	REQUIRE_THROWS_AS(pool.create(), std::runtime_error);
+	REQUIRE(pool.allocator().allocate() != nullptr);
+}
+
+TEST_CASE("msp::shared_ptr can allocate its objects from an object pool")
+{
+	int live = 0;
+	aeh::ObjectPool<aeh::msp::shared<tests::node>> pool(100);
+
+	{
+		auto p = aeh::msp::shared_ptr<tests::node, aeh::SlabAllocatorRef>::make_new(pool.ref(), pool.ref(), 5, live);
+		auto q = p;
+		REQUIRE(live == 1);
+		REQUIRE(p.use_count() == 2);
+		REQUIRE(q->value == 5);
+
+		auto r = std::move(p);
+		REQUIRE(r.use_count() == 2);
+	}
+
+	REQUIRE(live == 0);
+
+	// The memory went back to the pool.
+	void * const reused = pool.allocator().allocate();
+	void * const next = pool.allocator().allocate();
+	REQUIRE(static_cast<char *>(next) - static_cast<char *>(reused) == static_cast<std::ptrdiff_t>(pool.allocator().object_size()));
+}
+
+TEST_CASE("Many threads can allocate and deallocate from a slab allocator with thread local magazines")
+{
+	constexpr int thread_count = 4;
+	constexpr int objects_per_thread = 10000;
+	aeh::SlabAllocator slab(sizeof(int), alignof(int), thread_count * objects_per_thread, {.max_thread_count = thread_count - 1, .magazine_size = 16});
+
+	// Catch can't be used from other threads, so they record what went wrong to be checked once they are done.
+	std::atomic<int> objects_given_to_two_threads = 0;
+	{
+		std::vector<std::jthread> threads;
+		for (int t = 0; t < thread_count; ++t)
+			threads.emplace_back([&slab, &objects_given_to_two_threads, t]
+			{
+				std::vector<int *> objects;
+				for (int round = 0; round < 3; ++round)
+				{
+					for (int i = 0; i < objects_per_thread; ++i)
+					{
+						int * const object = static_cast<int *>(slab.allocate());
+						*object = t;
+						objects.push_back(object);
+					}
+
+					// Nobody else got the same objects.
+					objects_given_to_two_threads += static_cast<int>(std::count_if(objects.begin(), objects.end(), [t](int * object) { return *object != t; }));
+
+					for (int * object : objects)
+						slab.deallocate(object);
+					objects.clear();
+				}
+
+				slab.release_thread_cache();
+			});
+	}
+	REQUIRE(objects_given_to_two_threads == 0);
+
+	// Everything was given back, so the slab can be filled up again from a single thread.
+	for (int i = 0; i < thread_count * objects_per_thread; ++i)
+		REQUIRE(slab.allocate() != nullptr);
+}
+
+TEST_CASE("A thread can interleave allocations from many slab allocators with thread local magazines")
+{
+	// More allocators than the per-thread cache has room for, so that some of them are evicted and found again.
+	constexpr int allocator_count = 12;
+	constexpr int objects_per_allocator = 1000;
+	std::vector<std::unique_ptr<aeh::SlabAllocator>> slabs;
+	for (int i = 0; i < allocator_count; ++i)
+		slabs.push_back(std::make_unique<aeh::SlabAllocator>(sizeof(int), alignof(int), objects_per_allocator, aeh::SlabAllocatorOptions{.max_thread_count = 1, .magazine_size = 8}));
+
+	std::vector<std::vector<int *>> objects(allocator_count);
+	for (int round = 0; round < 2; ++round)
+	{
+		for (int i = 0; i < objects_per_allocator; ++i)
+		{
+			for (int s = 0; s < allocator_count; ++s)
+			{
+				int * const object = static_cast<int *>(slabs[s]->allocate());
+				REQUIRE(object != nullptr);
+				*object = s;
+				objects[s].push_back(object);
+			}
+		}
+
+		for (int s = 0; s < allocator_count; ++s)
+		{
+			REQUIRE(std::all_of(objects[s].begin(), objects[s].end(), [s](int * object) { return *object == s; }));
+			REQUIRE(std::set<int *>(objects[s].begin(), objects[s].end()).size() == objects_per_allocator);
+			for (int * object : objects[s])
+				slabs[s]->deallocate(object);
+			objects[s].clear();
+		}
+	}
+
+	// Releasing the magazine of an allocator whose cache entry was evicted still gives its objects back.
+	for (int s = 0; s < allocator_count; ++s)
+		slabs[s]->release_thread_cache();
+
+	// Another thread can take over the only magazine of every allocator and fill each one up.
+	int failed_allocations = 0;
+	std::jthread([&]
+	{
+		for (auto const & slab : slabs)
+			for (int i = 0; i < objects_per_allocator; ++i)
+				if (slab->allocate() == nullptr)
+					++failed_allocations;
+	}).join();
+	REQUIRE(failed_allocations == 0);
+}
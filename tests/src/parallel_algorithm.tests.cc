@@ -0,0 +1,90 @@
+#include "parallel_algorithm.hh"
+#include "thread_pool.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <functional>
+#include <numeric>
+#include <string>
+
+namespace tests
+{
+
+	struct worker_on_strike
+	{
+		void join() const {}
+	};
+	constexpr auto do_nothing = [](auto && ...) { return worker_on_strike(); };
+
+	static auto iota_vector(size_t size)
+	{
+		std::vector<size_t> v(size);
+		std::iota(v.begin(), v.end(), size_t(0));
+		return v;
+	}
+
+} // namespace tests
+
+TEST_CASE("parallel_for calls the function on every element exactly once")
+{
+	for (size_t const size : {0u, 1u, 7u, 1000u, 100003u})
+	{
+		std::vector<std::atomic<int>> calls(size);
+		aeh::parallel_for(calls.begin(), calls.end(), 3, [](std::atomic<int> & c) { c++; });
+
+		for (std::atomic<int> const & c : calls)
+			REQUIRE(c == 1);
+	}
+}
+
+TEST_CASE("parallel_transform writes every result to its position in the output")
+{
+	std::vector<size_t> const inputs = tests::iota_vector(10007);
+	std::vector<size_t> outputs(inputs.size());
+
+	auto const out_end = aeh::parallel_transform(inputs.begin(), inputs.end(), outputs.begin(), 3, [](size_t i) { return i * 2; });
+
+	REQUIRE(out_end == outputs.end());
+	for (size_t i = 0; i < outputs.size(); ++i)
+		REQUIRE(outputs[i] == i * 2);
+}
+
+TEST_CASE("parallel_transform_reduce gives the same result as std::transform_reduce")
+{
+	for (size_t const size : {0u, 1u, 2u, 5u, 1000u, 100003u})
+	{
+		std::vector<size_t> const inputs = tests::iota_vector(size);
+		auto const square = [](size_t i) { return i * i; };
+
+		size_t const expected = std::transform_reduce(inputs.begin(), inputs.end(), size_t(10), std::plus<>(), square);
+		REQUIRE(aeh::parallel_transform_reduce(inputs.begin(), inputs.end(), 3, size_t(10), std::plus<>(), square) == expected);
+	}
+}
+
+TEST_CASE("parallel_transform_reduce combines partials in range order, so reduce doesn't need to be commutative")
+{
+	std::vector<size_t> const inputs = tests::iota_vector(1000);
+	auto const to_string = [](size_t i) { return std::to_string(i) + ','; };
+
+	std::string expected = "start:";
+	for (size_t i : inputs)
+		expected += to_string(i);
+
+	REQUIRE(aeh::parallel_transform_reduce(inputs.begin(), inputs.end(), 5, std::string("start:"), std::plus<>(), to_string) == expected);
+}
+
+TEST_CASE("Parallel algorithms finish the work on the calling thread if workers never run")
+{
+	std::vector<size_t> const inputs = tests::iota_vector(1000);
+	size_t const expected = std::accumulate(inputs.begin(), inputs.end(), size_t(0));
+
+	REQUIRE(aeh::parallel_transform_reduce(inputs.begin(), inputs.end(), 7, size_t(0), std::plus<>(), std::identity(), tests::do_nothing) == expected);
+}
+
+TEST_CASE("Parallel algorithms can run on a thread pool")
+{
+	aeh::ThreadPool pool(3);
+	std::vector<size_t> const inputs = tests::iota_vector(10000);
+	size_t const expected = std::accumulate(inputs.begin(), inputs.end(), size_t(0));
+
+	for (int i = 0; i < 10; ++i)
+		REQUIRE(aeh::parallel_transform_reduce(inputs.begin(), inputs.end(), pool.thread_count(), size_t(0), std::plus<>(), std::identity(), pool) == expected);
+}
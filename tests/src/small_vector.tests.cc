@@ -0,0 +1,230 @@
+#include "small_vector.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace tests
+{
+
+	// Counts what goes through it, to check when small_vector allocates.
+	template <typename T>
+	struct CountingAllocator
+	{
+		using value_type = T;
+
+		CountingAllocator(int & allocations_) noexcept : allocations(&allocations_) {}
+
+		auto allocate(size_t n) -> T * { ++*allocations; return std::allocator<T>().allocate(n); }
+		auto deallocate(T * p, size_t n) -> void { --*allocations; std::allocator<T>().deallocate(p, n); }
+
+		int * allocations;
+	};
+
+	// Its move constructor throws for the value 2. Counts live instances, to check that nothing leaks when it does.
+	struct ThrowsOnMove
+	{
+		ThrowsOnMove(int value_, int & live_) noexcept : value(value_), live(&live_) { ++*live; }
+		ThrowsOnMove(ThrowsOnMove const & other) noexcept : value(other.value), live(other.live) { ++*live; }
+		ThrowsOnMove(ThrowsOnMove && other) : value(other.value), live(other.live) { if (value == 2) throw 0; ++*live; }
+		~ThrowsOnMove() { --*live; }
+
+		int value;
+		int * live;
+	};
+
+	// Without a copy constructor to fall back on, small_vector has to move it when it grows.
+	struct MoveOnlyThrowsOnMove : ThrowsOnMove
+	{
+		using ThrowsOnMove::ThrowsOnMove;
+		MoveOnlyThrowsOnMove(MoveOnlyThrowsOnMove const &) = delete;
+		MoveOnlyThrowsOnMove(MoveOnlyThrowsOnMove &&) = default;
+	};
+
+	template <typename Vector>
+	static auto fill(Vector & v, int n) -> void
+	{
+		for (int i = 0; i < n; ++i)
+			v.push_back(i);
+	}
+
+} // namespace tests
+
+TEST_CASE("A small_vector keeps its first elements inline")
+{
+	int allocations = 0;
+	aeh::small_vector<int, 8, tests::CountingAllocator<int>> v{tests::CountingAllocator<int>(allocations)};
+	REQUIRE(v.empty());
+	REQUIRE(v.capacity() == 8);
+
+	tests::fill(v, 8);
+	REQUIRE(v.is_inline());
+	REQUIRE(allocations == 0);
+	REQUIRE(v.size() == 8);
+	REQUIRE(v.back() == 7);
+}
+
+TEST_CASE("A small_vector moves to the heap when it grows past its inline capacity")
+{
+	int allocations = 0;
+	{
+		aeh::small_vector<std::string, 4, tests::CountingAllocator<std::string>> v{tests::CountingAllocator<std::string>(allocations)};
+		for (int i = 0; i < 1000; ++i)
+			v.push_back(std::to_string(i));
+
+		REQUIRE(!v.is_inline());
+		REQUIRE(allocations == 1);
+		REQUIRE(v.size() == 1000);
+		REQUIRE(v.capacity() >= 1000);
+		for (int i = 0; i < 1000; ++i)
+			REQUIRE(v[i] == std::to_string(i));
+
+		// Elements may refer to the vector itself when it grows.
+		v.resize(v.capacity());
+		v.push_back(v.front());
+		REQUIRE(v.back() == "0");
+	}
+	REQUIRE(allocations == 0);
+}
+
+TEST_CASE("shrink_to_fit moves the elements of a small_vector back inline when they fit")
+{
+	aeh::small_vector<std::string, 4> v = {"a", "b", "c", "d", "e"};
+	REQUIRE(!v.is_inline());
+
+	v.pop_back();
+	v.pop_back();
+	v.shrink_to_fit();
+	REQUIRE(v.is_inline());
+	REQUIRE(v == aeh::small_vector<std::string, 4>{"a", "b", "c"});
+
+	v.reserve(100);
+	REQUIRE(v.capacity() == 100);
+	v.resize(10, "x");
+	v.shrink_to_fit();
+	REQUIRE(v.capacity() == 10);
+	REQUIRE(v[9] == "x");
+}
+
+TEST_CASE("A throwing move in shrink_to_fit leaves the small_vector on the heap")
+{
+	int allocations = 0;
+	int live = 0;
+	{
+		aeh::small_vector<tests::ThrowsOnMove, 4, tests::CountingAllocator<tests::ThrowsOnMove>> v{tests::CountingAllocator<tests::ThrowsOnMove>(allocations)};
+		v.reserve(8);
+		for (int i = 0; i < 3; ++i)
+			v.emplace_back(i, live);
+
+		REQUIRE_THROWS(v.shrink_to_fit());
+		REQUIRE(!v.is_inline());
+		REQUIRE(v.size() == 3);
+		REQUIRE(v[2].value == 2);
+		REQUIRE(allocations == 1);
+	}
+	REQUIRE(allocations == 0);
+	REQUIRE(live == 0);
+}
+
+TEST_CASE("A small_vector copies elements whose move may throw when it grows")
+{
+	int allocations = 0;
+	int live = 0;
+	{
+		aeh::small_vector<tests::ThrowsOnMove, 4, tests::CountingAllocator<tests::ThrowsOnMove>> v{tests::CountingAllocator<tests::ThrowsOnMove>(allocations)};
+		for (int i = 0; i < 9; ++i)
+			v.emplace_back(i, live);
+
+		REQUIRE(v.size() == 9);
+		REQUIRE(v[2].value == 2);
+		REQUIRE(live == 9);
+	}
+	REQUIRE(allocations == 0);
+	REQUIRE(live == 0);
+}
+
+TEST_CASE("A throwing move when a small_vector grows frees the new buffer and element")
+{
+	int allocations = 0;
+	int live = 0;
+	{
+		aeh::small_vector<tests::MoveOnlyThrowsOnMove, 4, tests::CountingAllocator<tests::MoveOnlyThrowsOnMove>> v{tests::CountingAllocator<tests::MoveOnlyThrowsOnMove>(allocations)};
+		for (int i = 0; i < 4; ++i)
+			v.emplace_back(i, live);
+
+		// Growing from inline storage, and reserving, both move the element with value 2.
+		REQUIRE_THROWS(v.emplace_back(4, live));
+		REQUIRE_THROWS(v.reserve(16));
+		REQUIRE(v.is_inline());
+		REQUIRE(v.size() == 4);
+		REQUIRE(allocations == 0);
+		REQUIRE(live == 4);
+	}
+	REQUIRE(live == 0);
+}
+
+TEST_CASE("Copying and moving a small_vector")
+{
+	for (int const n : {3, 20})
+	{
+		aeh::small_vector<std::string, 4> a;
+		for (int i = 0; i < n; ++i)
+			a.push_back(std::to_string(i));
+
+		aeh::small_vector<std::string, 4> b = a;
+		REQUIRE(b == a);
+
+		aeh::small_vector<std::string, 4> c;
+		c = b;
+		REQUIRE(c == a);
+
+		std::string const * const data = c.data();
+		aeh::small_vector<std::string, 4> d = std::move(c);
+		REQUIRE(d == a);
+		REQUIRE(c.empty());
+		// Heap buffers change hands on move. Inline elements can't.
+		REQUIRE((d.data() == data) == (n > 4));
+
+		c = std::move(d);
+		REQUIRE(c == a);
+		REQUIRE(d.empty());
+	}
+}
+
+TEST_CASE("Erasing from a small_vector")
+{
+	for (int const n : {6, 30})
+	{
+		aeh::small_vector<int, 8> v;
+		tests::fill(v, n);
+
+		REQUIRE(*v.erase(v.nth(1)) == 2);
+		REQUIRE(*v.erase(v.nth(1), v.nth(3)) == 4);
+		REQUIRE(v.size() == size_t(n - 3));
+		REQUIRE(v[0] == 0);
+		REQUIRE(v[1] == 4);
+		REQUIRE(v.back() == n - 1);
+	}
+}
+
+TEST_CASE("small_vector vs std::vector for typical sizes", "[.][benchmark]")
+{
+	for (int const n : {4, 8, 64})
+	{
+		BENCHMARK("std::vector, size = " + std::to_string(n))
+		{
+			std::vector<int> v;
+			tests::fill(v, n);
+			return std::accumulate(v.begin(), v.end(), 0);
+		};
+
+		BENCHMARK("small_vector<int, 8>, size = " + std::to_string(n))
+		{
+			aeh::small_vector<int, 8> v;
+			tests::fill(v, n);
+			return std::accumulate(v.begin(), v.end(), 0);
+		};
+	}
+}
@@ -0,0 +1,145 @@
+#include "soa_vector.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+TEST_CASE("soa_vector stores every member in its own column")
+{
+	aeh::soa_vector<int, std::string, double> v;
+	REQUIRE(v.empty());
+
+	v.emplace_back(1, "one", 1.5);
+	v.push_back({2, "two", 2.5});
+	for (int i = 3; i <= 100; ++i)
+		v.emplace_back(i, std::to_string(i), i + 0.5);
+
+	REQUIRE(v.size() == 100);
+	REQUIRE(v.capacity() >= 100);
+
+	std::span<int const> const ints = std::as_const(v).column<0>();
+	std::span<double> const doubles = v.column<2>();
+	REQUIRE(ints.size() == 100);
+	REQUIRE(std::accumulate(ints.begin(), ints.end(), 0) == 5050);
+	REQUIRE(doubles[1] == 2.5);
+
+	// Every column must be aligned for its type, even when following a column of a smaller type.
+	REQUIRE(reinterpret_cast<uintptr_t>(doubles.data()) % alignof(double) == 0);
+	REQUIRE(reinterpret_cast<uintptr_t>(v.column<1>().data()) % alignof(std::string) == 0);
+
+	auto const [ints_span, strings_span, doubles_span] = v.columns();
+	REQUIRE(strings_span[0] == "one");
+	REQUIRE(ints_span.data() == ints.data());
+}
+
+TEST_CASE("soa_vector elements are accessed through tuples of references")
+{
+	using iterator = aeh::soa_vector<int, std::string>::iterator;
+	static_assert(std::is_same_v<std::iterator_traits<iterator>::iterator_category, std::input_iterator_tag>);
+
+	aeh::soa_vector<int, std::string> v = {{1, "a"}, {2, "b"}, {3, "c"}};
+
+	auto [number, name] = v[1];
+	number = 20;
+	name += "b";
+	REQUIRE(v.column<0>()[1] == 20);
+	REQUIRE(v.column<1>()[1] == "bb");
+
+	v[2] = std::tuple(30, "cc");
+	REQUIRE(v.back() == std::tuple(30, "cc"));
+
+	std::vector<std::string> names;
+	for (auto [n, s] : v)
+	{
+		n *= 2;
+		names.push_back(s);
+	}
+	REQUIRE(names == std::vector<std::string>{"a", "bb", "cc"});
+	REQUIRE(std::ranges::equal(v.column<0>(), std::vector<int>{2, 40, 60}));
+
+	auto const & const_v = v;
+	REQUIRE(std::get<1>(*const_v.begin()) == "a");
+	REQUIRE(const_v.end() - const_v.begin() == 3);
+}
+
+TEST_CASE("soa_vector copies, moves and removes elements in every column")
+{
+	aeh::soa_vector<std::string, char> v;
+	for (int i = 0; i < 20; ++i)
+		v.emplace_back(std::string(40, static_cast<char>('a' + i)), static_cast<char>('a' + i));
+
+	aeh::soa_vector<std::string, char> copy = v;
+	REQUIRE(copy == v);
+	REQUIRE(copy.capacity() == 20);
+
+	v.swap_and_pop(0);
+	REQUIRE(v.size() == 19);
+	REQUIRE(v.front() == std::tuple(std::string(40, 't'), 't'));
+	REQUIRE(copy != v);
+
+	v.pop_back();
+	v.resize(25);
+	REQUIRE(v.size() == 25);
+	REQUIRE(v.back() == std::tuple(std::string(), '\0'));
+	v.resize(5);
+	v.shrink_to_fit();
+	REQUIRE(v.capacity() == 5);
+	REQUIRE(std::ranges::equal(v.column<1>(), std::string("tbcde")));
+
+	aeh::soa_vector<std::string, char> moved = std::move(v);
+	REQUIRE(moved.size() == 5);
+	REQUIRE(v.empty());
+	REQUIRE(v.capacity() == 0);
+
+	copy = moved;
+	REQUIRE(copy == moved);
+	moved.clear();
+	REQUIRE(moved.empty());
+	REQUIRE(copy.size() == 5);
+}
+
+namespace
+{
+	struct Particle
+	{
+		float position[3];
+		float velocity[3];
+		float mass;
+		int id;
+	};
+}
+
+TEST_CASE("soa_vector vs array of structs summing one member", "[.][benchmark]")
+{
+	constexpr int size = 100'000;
+
+	std::vector<Particle> aos(size);
+	aeh::soa_vector<float, int> soa;
+	for (int i = 0; i < size; ++i)
+	{
+		aos[i].mass = static_cast<float>(i % 7);
+		aos[i].id = i;
+		soa.emplace_back(static_cast<float>(i % 7), i);
+	}
+
+	BENCHMARK("Array of structs")
+	{
+		float total = 0;
+		for (Particle const & particle : aos)
+			total += particle.mass;
+		return total;
+	};
+
+	BENCHMARK("soa_vector column")
+	{
+		float total = 0;
+		for (float const mass : soa.column<0>())
+			total += mass;
+		return total;
+	};
+}
@@ -0,0 +1,129 @@
+#include "stable_vector.hh"
+#include "virtual_memory.hh"
+#include <span>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("Default constructed stable_vector is empty")
+{
+	aeh::stable_vector<int> v;
+	REQUIRE(v.size() == 0);
+	REQUIRE(v.empty());
+	REQUIRE(v.capacity() == 0);
+	REQUIRE(v.max_size() == 0);
+}
+
+TEST_CASE("Elements of a stable_vector don't move when it grows")
+{
+	aeh::stable_vector<std::string> v(1'000'000);
+	REQUIRE(v.max_size() == 1'000'000);
+
+	std::string const * const first = &v.emplace_back("first element, long enough to not fit in the small string buffer");
+	std::vector<std::string const *> addresses;
+	for (int i = 0; i < 100'000; ++i)
+		addresses.push_back(&v.emplace_back(std::to_string(i)));
+
+	REQUIRE(v.size() == 100'001);
+	REQUIRE(&v.front() == first);
+	REQUIRE(v.front() == "first element, long enough to not fit in the small string buffer");
+	for (int i = 0; i < 100'000; ++i)
+	{
+		REQUIRE(addresses[i] == &v[i + 1]);
+		REQUIRE(v[i + 1] == std::to_string(i));
+	}
+}
+
+TEST_CASE("stable_vector commits memory as it grows")
+{
+	aeh::stable_vector<int> v(1'000'000);
+	REQUIRE(v.capacity() == 0);
+
+	v.push_back(1);
+	REQUIRE(v.capacity() >= 1);
+	REQUIRE(v.capacity() < v.max_size());
+
+	v.resize(300'000, 5);
+	REQUIRE(v.size() == 300'000);
+	REQUIRE(v.capacity() >= 300'000);
+	REQUIRE(v[0] == 1);
+	REQUIRE(v[299'999] == 5);
+
+	v.reserve(v.max_size());
+	REQUIRE(v.capacity() == v.max_size());
+}
+
+TEST_CASE("shrink_to_fit decommits the pages past the last element")
+{
+	size_t const ints_per_page = aeh::os_memory_page_size / sizeof(int);
+
+	aeh::stable_vector<int> v(100 * ints_per_page);
+	v.resize(50 * ints_per_page);
+	REQUIRE(v.capacity() >= 50 * ints_per_page);
+
+	int const * const data = v.data();
+	v.resize(3 * ints_per_page + 1);
+	v.shrink_to_fit();
+	REQUIRE(v.capacity() == 4 * ints_per_page);
+	REQUIRE(v.data() == data);
+
+	v.clear();
+	v.shrink_to_fit();
+	REQUIRE(v.capacity() == 0);
+
+	// Decommitted memory can be committed again.
+	v.push_back(3);
+	REQUIRE(v.back() == 3);
+}
+
+TEST_CASE("Moving a stable_vector doesn't move its elements")
+{
+	aeh::stable_vector<int> a(1000);
+	a.assign(std::vector<int>{1, 2, 3});
+	int const * const data = a.data();
+
+	aeh::stable_vector<int> b = std::move(a);
+	REQUIRE(b.data() == data);
+	REQUIRE(b.size() == 3);
+	REQUIRE(a.empty());
+
+	aeh::stable_vector<int> c(10);
+	c = std::move(b);
+	REQUIRE(c.data() == data);
+	REQUIRE(std::span<int const>(c).size() == 3);
+}
+
+TEST_CASE("Copying a stable_vector copies its elements")
+{
+	aeh::stable_vector<std::string> a(1000);
+	a.assign(std::vector<std::string>{"a", "b", "c"});
+
+	aeh::stable_vector<std::string> b = a;
+	REQUIRE(b == a);
+	REQUIRE(b.max_size() == a.max_size());
+	REQUIRE(b.data() != a.data());
+
+	aeh::stable_vector<std::string> c(2);
+	c = a;
+	REQUIRE(c == a);
+
+	c.push_back("d");
+	REQUIRE(c > a);
+}
+
+TEST_CASE("Erasing from a stable_vector")
+{
+	aeh::stable_vector<int> v(100);
+	v.assign(std::vector<int>{0, 1, 2, 3, 4, 5});
+
+	REQUIRE(*v.erase(v.nth(1)) == 2);
+	REQUIRE(v.size() == 5);
+	REQUIRE(*v.erase(v.nth(1), v.nth(3)) == 4);
+	REQUIRE(v.size() == 3);
+	REQUIRE(v[0] == 0);
+	REQUIRE(v[1] == 4);
+	REQUIRE(v[2] == 5);
+
+	v.pop_back();
+	REQUIRE(v.back() == 4);
+}
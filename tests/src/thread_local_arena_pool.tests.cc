@@ -0,0 +1,87 @@
+#include "thread_local_arena_pool.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <barrier>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Each thread gets its own arena from a thread local arena pool")
+{
+	aeh::ThreadLocalArenaPool pool(4, 1024 * 1024);
+
+	aeh::MemoryArena & main_arena = pool.local_arena();
+	REQUIRE(&pool.local_arena() == &main_arena);
+	REQUIRE(pool.thread_count() == 1);
+
+	aeh::MemoryArena * other_arena = nullptr;
+	std::jthread([&] { other_arena = &pool.local_arena(); }).join();
+
+	REQUIRE(other_arena != &main_arena);
+	REQUIRE(pool.thread_count() == 2);
+}
+
+TEST_CASE("A thread uses a different arena for each pool")
+{
+	aeh::ThreadLocalArenaPool pool1(2, 1024 * 1024);
+	aeh::ThreadLocalArenaPool pool2(2, 1024 * 1024);
+
+	aeh::MemoryArena & arena1 = pool1.local_arena();
+	aeh::MemoryArena & arena2 = pool2.local_arena();
+	REQUIRE(&arena1 != &arena2);
+
+	// Switching between pools finds the same arena again.
+	REQUIRE(&pool1.local_arena() == &arena1);
+	REQUIRE(&pool2.local_arena() == &arena2);
+	REQUIRE(pool1.thread_count() == 1);
+}
+
+TEST_CASE("A thread keeps its arenas when it alternates between more pools than it caches")
+{
+	std::vector<std::unique_ptr<aeh::ThreadLocalArenaPool>> pools;
+	std::vector<aeh::MemoryArena *> arenas;
+	for (int i = 0; i < 12; ++i)
+	{
+		pools.push_back(std::make_unique<aeh::ThreadLocalArenaPool>(1, 64 * 1024));
+		arenas.push_back(&pools.back()->local_arena());
+	}
+
+	for (int round = 0; round < 3; ++round)
+		for (size_t i = 0; i < pools.size(); ++i)
+			REQUIRE(&pools[i]->local_arena() == arenas[i]);
+}
+
+TEST_CASE("Arenas of a thread local arena pool can be reset at once between frames")
+{
+	constexpr int thread_count = 4;
+	constexpr int frame_count = 3;
+	aeh::ThreadLocalArenaPool pool(thread_count, 1024 * 1024);
+
+	// The main thread checks and resets the arenas while every worker waits at the barrier.
+	std::barrier frame_boundary(thread_count + 1);
+	{
+		std::vector<std::jthread> threads;
+		for (int t = 0; t < thread_count; ++t)
+			threads.emplace_back([&pool, &frame_boundary]
+			{
+				for (int frame = 0; frame < frame_count; ++frame)
+				{
+					aeh::MemoryArena & arena = pool.local_arena();
+					int * const p = static_cast<int *>(arena.allocate(1000 * sizeof(int), alignof(int)));
+					std::fill_n(p, 1000, frame);
+					frame_boundary.arrive_and_wait();
+					frame_boundary.arrive_and_wait();
+				}
+			});
+
+		for (int frame = 0; frame < frame_count; ++frame)
+		{
+			frame_boundary.arrive_and_wait();
+			REQUIRE(pool.thread_count() == thread_count);
+			REQUIRE(pool.allocated_bytes() == thread_count * 1000 * sizeof(int));
+			pool.reset_all();
+			REQUIRE(pool.allocated_bytes() == 0);
+			frame_boundary.arrive_and_wait();
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#include "thread_pool.hh"
+#include "batched_parallel_work.hh"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <numeric>
+#include <stdexcept>
+
+namespace tests
+{
+
+	static size_t square(size_t i)
+	{
+		return i * i;
+	}
+
+	static auto accumulate_into(size_t & total)
+	{
+		return [&total](size_t results[], size_t result_count)
+		{
+			total = std::accumulate(results, results + result_count, total);
+		};
+	}
+
+	static size_t sum_of_squares(size_t n)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < n; ++i)
+			total += square(i);
+		return total;
+	}
+
+} // namespace tests
+
+TEST_CASE("A thread pool runs the jobs it is given")
+{
+	aeh::ThreadPool pool(4);
+	REQUIRE(pool.thread_count() == 4);
+
+	std::atomic<int> counter = 0;
+	std::vector<aeh::ThreadPool::Task> tasks;
+	for (int i = 0; i < 100; ++i)
+		tasks.push_back(pool([&counter](int amount) { counter += amount; }, 2));
+
+	for (aeh::ThreadPool::Task & task : tasks)
+	{
+		REQUIRE(task.joinable());
+		task.join();
+		REQUIRE(!task.joinable());
+	}
+
+	REQUIRE(counter == 200);
+}
+
+TEST_CASE("Joining a task that no worker has picked up runs it on the joining thread")
+{
+	aeh::ThreadPool pool(0);
+
+	std::thread::id ran_on;
+	aeh::ThreadPool::Task task = pool([&ran_on] { ran_on = std::this_thread::get_id(); });
+	task.join();
+
+	REQUIRE(ran_on == std::this_thread::get_id());
+}
+
+TEST_CASE("Exceptions thrown by a job are rethrown on join")
+{
+	aeh::ThreadPool pool(1);
+
+	aeh::ThreadPool::Task task = pool([] { throw std::runtime_error("job failed"); });
+	REQUIRE_THROWS_AS(task.join(), std::runtime_error);
+}
+
+TEST_CASE("A thread pool can be used as the executor of batched_parallel_work")
+{
+	aeh::ThreadPool pool(3);
+
+	// Same pool, several jobs, to check that workers are reused between calls.
+	for (size_t const task_count : {0u, 1u, 99u, 100u, 1001u})
+	{
+		size_t total = 0;
+		aeh::batched_parallel_work(task_count, 10, pool.thread_count(), tests::square, tests::accumulate_into(total), pool);
+		REQUIRE(total == tests::sum_of_squares(task_count));
+	}
+}
+
+TEST_CASE("Thread pool vs new threads for small jobs", "[.][benchmark]")
+{
+	size_t const worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	aeh::ThreadPool pool(worker_count);
+
+	for (size_t const task_count : {64u, 1024u, 16384u})
+	{
+		size_t total = 0;
+
+		BENCHMARK("run_in_new_thread, total_work = " + std::to_string(task_count))
+		{
+			aeh::batched_parallel_work(task_count, 64, worker_count, tests::square, tests::accumulate_into(total));
+			return total;
+		};
+
+		BENCHMARK("ThreadPool, total_work = " + std::to_string(task_count))
+		{
+			aeh::batched_parallel_work(task_count, 64, worker_count, tests::square, tests::accumulate_into(total), pool);
+			return total;
+		};
+	}
+}
+
+TEST_CASE("Jobs posted to a thread pool run without a handle to join")
+{
+	// Declared before the pool so that it outlives jobs that are still returning.
+	std::atomic<int> counter = 0;
+	aeh::ThreadPool pool(2);
+
+	for (int i = 0; i < 100; ++i)
+		pool.post([&counter] { counter++; counter.notify_all(); });
+
+	for (int current = counter; current != 100; current = counter)
+		counter.wait(current);
+	REQUIRE(counter == 100);
+}
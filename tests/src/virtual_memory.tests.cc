@@ -1,5 +1,6 @@
 #include "virtual_memory.hh"
 #include <catch2/catch_test_macros.hpp>
+#include <bit>
 #include <cstring>
 
 TEST_CASE("Default constructed virtual memory region has no memory allocated")
@@ -192,3 +193,84 @@ TEST_CASE("free_all_pages_of_physical_memory_up_to frees all physical memory exc
 	region.free_all_pages_of_physical_memory_up_to(2000);
 	REQUIRE(region.physical_memory_size_in_pages() == 2);
 }
+
+TEST_CASE("Subregions commit physical memory independently of the region they were made from")
+{
+	aeh::VirtualMemoryRegion region = aeh::VirtualMemoryRegion::reserve_pages_of_virtual_memory(16);
+	aeh::VirtualMemoryRegion subregion = region.subregion(8, 8);
+
+	REQUIRE(region.owns_virtual_memory());
+	REQUIRE(!subregion.owns_virtual_memory());
+	REQUIRE(subregion.memory_region_address() == static_cast<char *>(region.memory_region_address()) + 8 * aeh::os_memory_page_size);
+	REQUIRE(subregion.virtual_memory_size_in_pages() == 8);
+
+	subregion.allocate_extra_pages_of_physical_memory(2);
+	static_cast<int *>(subregion.memory_region_address())[0] = 5;
+	REQUIRE(subregion.physical_memory_size_in_pages() == 2);
+	REQUIRE(region.physical_memory_size_in_pages() == 0);
+
+	// Freeing the subregion leaves the reservation to the region.
+	subregion.free_virtual_memory_region();
+	REQUIRE(subregion.memory_region_address() == nullptr);
+	region.allocate_extra_pages_of_physical_memory(16);
+	static_cast<int *>(region.memory_region_address())[0] = 5;
+}
+
+TEST_CASE("Regions that ask for huge pages use them when the system has them and fall back to default pages otherwise")
+{
+	aeh::VirtualMemoryRegion region = aeh::VirtualMemoryRegion::reserve_bytes_of_virtual_memory(3 * 1024 * 1024, aeh::PageSize::huge);
+	REQUIRE(region.memory_region_address() != nullptr);
+	REQUIRE((region.page_size() == aeh::huge_memory_page_size || region.page_size() == aeh::os_memory_page_size));
+	if (aeh::huge_memory_page_size > 0)
+		REQUIRE((aeh::huge_memory_page_size % aeh::os_memory_page_size == 0 && std::has_single_bit(aeh::huge_memory_page_size)));
+
+	// Sizes are whole pages of the size the region got.
+	REQUIRE(region.virtual_memory_size_in_bytes() >= 3 * 1024 * 1024);
+	REQUIRE(region.virtual_memory_size_in_bytes() % region.page_size() == 0);
+	REQUIRE(reinterpret_cast<uintptr_t>(region.memory_region_address()) % region.page_size() == 0);
+
+	region.allocate_extra_pages_of_physical_memory(1);
+	REQUIRE(region.physical_memory_size_in_bytes() == region.page_size());
+	char * const memory = static_cast<char *>(region.memory_region_address());
+	memory[0] = 1;
+	memory[region.page_size() - 1] = 1;
+
+	region.free_all_pages_of_physical_memory_up_to(0);
+	REQUIRE(region.physical_memory_size_in_pages() == 0);
+}
+
+TEST_CASE("Prefaulted pages can be used like any other committed pages")
+{
+	aeh::VirtualMemoryRegion region = aeh::VirtualMemoryRegion::reserve_pages_of_virtual_memory(16);
+
+	region.allocate_extra_pages_of_physical_memory(4, aeh::Prefault::yes);
+	REQUIRE(region.physical_memory_size_in_pages() == 4);
+
+	char * const memory = static_cast<char *>(region.memory_region_address());
+	REQUIRE(memory[0] == 0);
+	memory[4 * aeh::os_memory_page_size - 1] = 1;
+}
+
+TEST_CASE("Both copies of a mirrored memory region are the same memory")
+{
+	aeh::MirroredMemoryRegion region = aeh::MirroredMemoryRegion::map_bytes_of_mirrored_memory(1);
+	REQUIRE(region.memory_region_address() != nullptr);
+	REQUIRE(region.size_in_bytes() == aeh::mirrored_memory_granularity);
+
+	char * const memory = static_cast<char *>(region.memory_region_address());
+	size_t const size = region.size_in_bytes();
+	memory[0] = 1;
+	memory[size - 1] = 2;
+	REQUIRE(memory[size] == 1);
+	REQUIRE(memory[2 * size - 1] == 2);
+
+	// A write that crosses the end of the first copy wraps around to its beginning.
+	std::memcpy(memory + size - 2, "abcd", 4);
+	REQUIRE(std::memcmp(memory, "cd", 2) == 0);
+
+	aeh::MirroredMemoryRegion moved = std::move(region);
+	REQUIRE(region.memory_region_address() == nullptr);
+	REQUIRE(moved.memory_region_address() == memory);
+	REQUIRE(moved.free_mirrored_memory_region());
+	REQUIRE(moved.size_in_bytes() == 0);
+}